@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "avrtos/avrtos_delay.h"
+#include "avrtos/avrtos_init.h"
+
+#include "host.h"
+
+#define HOST_TASKS_MAX 4
+#define HOST_TASK_STACK_SIZE (64 * 1024)
+
+#define CYCLES_PER_US (F_CPU / 1000000UL)
+#define STACK_PAINT 0xa5
+
+static struct {
+    ucontext_t context;
+    uint8_t *stack;
+    avrtos_task_function_t *function;
+    void *arg;
+    uint64_t wake_cycles;
+} tasks[HOST_TASKS_MAX];
+
+static ucontext_t scheduler_context;
+static uint8_t tasks_count;
+static int8_t current_task = -1;
+static uint64_t now_cycles;
+
+uint64_t host_clock_cycles(void) {
+    return now_cycles;
+}
+
+void host_clock_spend(uint64_t cycles) {
+    if (current_task < 0) {
+        now_cycles += cycles;
+    }
+}
+
+static void task_entry(void) {
+    tasks[current_task].function(tasks[current_task].arg);
+
+    fprintf(stderr, "host: task %d returned\n", current_task);
+    exit(EXIT_FAILURE);
+}
+
+int avrtos_task_create(avrtos_task_t *task,
+                       avrtos_task_function_t *function,
+                       uint8_t *stack,
+                       size_t stack_size,
+                       void *arg) {
+    (void) stack;
+    (void) stack_size;
+
+    if (tasks_count == HOST_TASKS_MAX) {
+        return -1;
+    }
+
+    uint8_t *host_stack = malloc(HOST_TASK_STACK_SIZE);
+    if (!host_stack) {
+        return -1;
+    }
+    memset(host_stack, STACK_PAINT, HOST_TASK_STACK_SIZE);
+
+    ucontext_t *context = &tasks[tasks_count].context;
+    getcontext(context);
+    context->uc_stack.ss_sp = host_stack;
+    context->uc_stack.ss_size = HOST_TASK_STACK_SIZE;
+    context->uc_link = NULL;
+    makecontext(context, task_entry, 0);
+
+    tasks[tasks_count].stack = host_stack;
+
+    tasks[tasks_count].function = function;
+    tasks[tasks_count].arg = arg;
+    tasks[tasks_count].wake_cycles = now_cycles;
+    task->id = tasks_count;
+    tasks_count++;
+
+    return 0;
+}
+
+uint8_t host_tasks_count(void) {
+    return tasks_count;
+}
+
+size_t host_task_stack_high_water(uint8_t id) {
+    size_t unused = 0;
+    while (unused < HOST_TASK_STACK_SIZE
+           && tasks[id].stack[unused] == STACK_PAINT) {
+        unused++;
+    }
+
+    return HOST_TASK_STACK_SIZE - unused;
+}
+
+static uint64_t next_event(void) {
+    uint64_t next = host_hardware_next_event();
+    uint64_t sim_next = host_sim_next_event();
+    if (sim_next < next) {
+        next = sim_next;
+    }
+    for (uint8_t i = 0; i < tasks_count; i++) {
+        if (tasks[i].wake_cycles < next) {
+            next = tasks[i].wake_cycles;
+        }
+    }
+
+    return next;
+}
+
+void avrtos_scheduler_start(void) {
+    while (1) {
+        uint64_t next = next_event();
+        if (next == HOST_NO_EVENT) {
+            fprintf(stderr, "host: nothing left to simulate\n");
+            exit(EXIT_FAILURE);
+        }
+        if (next > now_cycles) {
+            now_cycles = next;
+        }
+
+        host_hardware_run_until(now_cycles);
+        host_sim_run_until(now_cycles);
+
+        for (uint8_t i = 0; i < tasks_count; i++) {
+            if (tasks[i].wake_cycles <= now_cycles) {
+                current_task = i;
+                swapcontext(&scheduler_context, &tasks[i].context);
+                current_task = -1;
+            }
+        }
+    }
+}
+
+static void delay_cycles(uint64_t cycles) {
+    if (current_task < 0) {
+        now_cycles += cycles;
+        return;
+    }
+
+    tasks[current_task].wake_cycles = now_cycles + cycles;
+    swapcontext(&tasks[current_task].context, &scheduler_context);
+}
+
+void avrtos_delay_ms(uint32_t ms) {
+    delay_cycles((uint64_t) ms * 1000 * CYCLES_PER_US);
+}
+
+void avrtos_delay_us(uint32_t us) {
+    delay_cycles((uint64_t) us * CYCLES_PER_US);
+}
+
+uint64_t _avrtos_delay_get_microseconds(void) {
+    return now_cycles / CYCLES_PER_US;
+}
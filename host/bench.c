@@ -0,0 +1,167 @@
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "gametoy.h"
+
+#include "bench.h"
+#include "host.h"
+
+/*
+ * Micro-benchmarks of the game hot paths over representative and worst-case
+ * board states. The numbers are host nanoseconds, so they are only
+ * meaningful relative to each other and to the recorded budgets, which
+ * catch algorithmic regressions (e.g. a per-move cost growing with the
+ * snake length) rather than absolute AVR cycle counts.
+ *
+ * The budgets were recorded on a host where the calibration case below took
+ * BENCH_CALIBRATION_REFERENCE_NS. They are scaled by the calibration median
+ * measured on the running host, so -c holds on faster or slower machines.
+ */
+
+// median of the calibration case on the host the budgets were recorded on
+#define BENCH_CALIBRATION_REFERENCE_NS 400
+#define BENCH_CALIBRATION_ROUNDS 256
+
+static const struct {
+    const bench_case_t *cases;
+    const size_t *count;
+} SUITES[] = {{bench_tetris_cases, &bench_tetris_cases_count},
+              {bench_snake_cases, &bench_snake_cases_count},
+              {bench_display_cases, &bench_display_cases_count},
+              {bench_gametoy_cases, &bench_gametoy_cases_count}};
+
+// the benchmarks never start the scheduler
+uint64_t host_sim_next_event(void) {
+    return HOST_NO_EVENT;
+}
+
+void host_sim_run_until(uint64_t cycles) {
+    (void) cycles;
+}
+
+static uint16_t points_framebuffer[5];
+
+static void setup_points_framebuffer(void) {
+    for (uint8_t i = 0; i < 5; i++) {
+        points_framebuffer[i] = 0;
+    }
+}
+
+static void run_gametoy_update_points_framebuffer(void) {
+    gametoy_update_points_framebuffer(points_framebuffer, 999);
+}
+
+const bench_case_t bench_gametoy_cases[] = {
+        {"gametoy_update_points_framebuffer/999", setup_points_framebuffer,
+         run_gametoy_update_points_framebuffer, 150},
+};
+const size_t bench_gametoy_cases_count =
+        sizeof(bench_gametoy_cases) / sizeof(bench_gametoy_cases[0]);
+
+// a fixed chain of dependent integer operations, like the game code
+static volatile uint32_t calibration_state = 0x2545f491;
+
+static void run_calibration(void) {
+    uint32_t x = calibration_state;
+    for (uint16_t i = 0; i < BENCH_CALIBRATION_ROUNDS; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+    }
+    calibration_state = x;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int sample_compare(const void *a, const void *b) {
+    uint64_t sa = *(const uint64_t *) a;
+    uint64_t sb = *(const uint64_t *) b;
+
+    return sa < sb ? -1 : sa > sb;
+}
+
+// the budget is scaled by scale_ppm, the median is left in median_ns
+static bool bench_run(const bench_case_t *bench, uint32_t iterations,
+                      bool check, uint64_t scale_ppm, uint64_t *median_ns) {
+    uint64_t *samples = malloc(iterations * sizeof(*samples));
+    uint64_t sum = 0;
+
+    if (!samples) {
+        perror("bench");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (bench->setup) {
+            bench->setup();
+        }
+        uint64_t start = now_ns();
+        bench->run();
+        samples[i] = now_ns() - start;
+        sum += samples[i];
+    }
+    qsort(samples, iterations, sizeof(*samples), sample_compare);
+
+    // the median is checked, min and max are dominated by the host caches
+    // and by preemption respectively
+    uint64_t median = samples[iterations / 2];
+    uint64_t budget_ns = (uint64_t) bench->budget_ns * scale_ppm / 1000000;
+    bool ok = !check || median <= budget_ns;
+    printf("%-40s %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64
+           " %8" PRIu64 " %s\n",
+           bench->name, samples[0], sum / iterations, median,
+           samples[iterations - 1], budget_ns, ok ? "" : "OVER BUDGET");
+    free(samples);
+    *median_ns = median;
+
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 10000;
+    bool check = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            check = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations] [-c]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    bool ok = true;
+    printf("%-40s %8s %8s %8s %8s %8s\n", "benchmark [ns]", "min", "mean",
+           "median", "max", "budget");
+    static const bench_case_t CALIBRATION = {
+            "calibration", NULL, run_calibration,
+            BENCH_CALIBRATION_REFERENCE_NS};
+    uint64_t median_ns;
+    bench_run(&CALIBRATION, iterations, false, 1000000, &median_ns);
+    uint64_t scale_ppm = median_ns * 1000000 / BENCH_CALIBRATION_REFERENCE_NS;
+    for (size_t i = 0; i < sizeof(SUITES) / sizeof(SUITES[0]); i++) {
+        for (size_t j = 0; j < *SUITES[i].count; j++) {
+            ok &= bench_run(&SUITES[i].cases[j], iterations, check, scale_ppm,
+                            &median_ns);
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
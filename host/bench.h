@@ -0,0 +1,23 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+typedef struct {
+    const char *name;
+    void (*setup)(void); // untimed, called before every run
+    void (*run)(void);
+    uint32_t budget_ns;  // allowed median time per run
+} bench_case_t;
+
+extern const bench_case_t bench_tetris_cases[];
+extern const size_t bench_tetris_cases_count;
+extern const bench_case_t bench_snake_cases[];
+extern const size_t bench_snake_cases_count;
+extern const bench_case_t bench_display_cases[];
+extern const size_t bench_display_cases_count;
+extern const bench_case_t bench_gametoy_cases[];
+extern const size_t bench_gametoy_cases_count;
+
+#endif /* BENCH_H_ */
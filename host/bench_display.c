@@ -0,0 +1,67 @@
+#include "display.c"
+
+#include "bench.h"
+#include "utils.h"
+
+// a frame is one row interrupt per row and bit-plane
+static uint16_t display_bench_planes[DISPLAY_DEPTH_MAX * GAMETOY_DISPLAY_SIZE];
+
+// a game screen's worth of layers, the scan composes every row from them
+static display_layer_t display_bench_layers[7];
+
+static void setup_display(uint8_t depth) {
+    for (uint8_t i = 0; i < DISPLAY_DEPTH_MAX * GAMETOY_DISPLAY_SIZE; i++) {
+        display_bench_planes[i] = 0x5a5a ^ i;
+    }
+    display_init(display_bench_planes);
+    display_framebuffer_flip_planes(display_bench_planes, depth);
+    // take the flip so the next frame starts at row 0 of the new depth
+    display_row = GAMETOY_DISPLAY_SIZE - 1;
+    display_plane = display_depth - 1;
+    TIMER1_COMPA_vect();
+}
+
+static void setup_display_layers(void) {
+    for (uint8_t i = 0; i < DISPLAY_DEPTH_MAX * GAMETOY_DISPLAY_SIZE; i++) {
+        display_bench_planes[i] = 0x5a5a ^ i;
+    }
+    for (uint8_t i = 0; i < ARRAY_SIZE(display_bench_layers); i++) {
+        display_bench_layers[i] = (display_layer_t){
+                .rows = i % 2 ? display_bench_planes : NULL,
+                .first_row = 4 * i,
+                .row_count = GAMETOY_DISPLAY_SIZE - 4 * i,
+                .mask = 0x8001,
+                .planes = i % 2 ? DISPLAY_LAYER_FULL : DISPLAY_LAYER_DIMMED};
+    }
+    display_init(NULL);
+    display_layers_show(display_bench_layers,
+                        ARRAY_SIZE(display_bench_layers), 2);
+    display_row = GAMETOY_DISPLAY_SIZE - 1;
+    display_plane = display_depth - 1;
+    TIMER1_COMPA_vect();
+}
+
+static void setup_display_depth_1(void) {
+    setup_display(1);
+}
+
+static void setup_display_depth_2(void) {
+    setup_display(2);
+}
+
+static void run_display_frame(void) {
+    for (uint8_t i = 0; i < GAMETOY_DISPLAY_SIZE * display_depth; i++) {
+        TIMER1_COMPA_vect();
+    }
+}
+
+const bench_case_t bench_display_cases[] = {
+        {"display frame/1 bit-plane", setup_display_depth_1, run_display_frame,
+         4000},
+        {"display frame/2 bit-planes", setup_display_depth_2,
+         run_display_frame, 8000},
+        {"display frame/7 layers", setup_display_layers, run_display_frame,
+         12000},
+};
+const size_t bench_display_cases_count =
+        ARRAY_SIZE(bench_display_cases);
@@ -0,0 +1,56 @@
+#include "snake.c"
+
+#include "bench.h"
+
+#define LONG_SNAKE_LEN 300
+
+// cells of a serpentine path filling the board row by row
+static coordinates_t serpentine_cell(uint16_t n) {
+    coordinates_t cell;
+    cell.y = n / COLS;
+    cell.x = cell.y % 2 == 0 ? 1 + n % COLS : COLS - n % COLS;
+
+    return cell;
+}
+
+// move leading from cell n of the serpentine path to cell n + 1
+static move_t serpentine_move(uint16_t n) {
+    if ((n + 1) % COLS == 0) {
+        return MOVE_DOWN;
+    }
+
+    return (n / COLS) % 2 == 0 ? MOVE_RIGHT : MOVE_LEFT;
+}
+
+// the head is about to move into the next free cell of the path
+static void setup_long_snake(void) {
+    memset(&framebuffers, 0, sizeof(framebuffers));
+    snake_tail = serpentine_cell(0);
+    snake_head = snake_tail;
+    snake_tail_move = 0;
+    snake_set_framebuffer(&snake_head, 1);
+    for (snake_len = 1; snake_len < LONG_SNAKE_LEN; snake_len++) {
+        snake_moves_set(snake_moves_index(snake_len - 1),
+                        serpentine_move(snake_len - 1));
+        snake_head = serpentine_cell(snake_len);
+        snake_set_framebuffer(&snake_head, 1);
+    }
+    next_move = MOVE_LEFT;
+    food = serpentine_cell(ROWS * COLS - COLS);
+    food_set_framebuffer(&food, 1);
+}
+
+static void run_snake_move(void) {
+    snake_move();
+}
+
+static void run_food_generate_new(void) {
+    food_generate_new();
+}
+
+const bench_case_t bench_snake_cases[] = {
+        {"snake_move/300 segments", setup_long_snake, run_snake_move, 150},
+        {"food_generate_new/300 segments", setup_long_snake,
+         run_food_generate_new, 300},
+};
+const size_t bench_snake_cases_count = ARRAY_SIZE(bench_snake_cases);
@@ -0,0 +1,85 @@
+#include "tetris.c"
+
+#include "bench.h"
+
+#define PLAYFIELD_MASK ((uint16_t) ~WALLS)
+
+static void well_reset(void) {
+    memset(&framebuffers, 0, sizeof(framebuffers));
+    memset(&current_block, 0, sizeof(current_block));
+    points_counter = 0;
+    well_column_top_rebuild();
+}
+
+// every row below the first four has a single hole, so no line is full
+static void well_fill_with_holes(uint8_t first_row) {
+    for (uint8_t i = first_row; i < ARRAY_SIZE(framebuffers.old_blocks);
+         i++) {
+        framebuffers.old_blocks[i] = PLAYFIELD_MASK & ~(1 << (2 + i % 12));
+    }
+    well_column_top_rebuild();
+}
+
+static void block_spawn(block_type_t block, uint8_t rows_down) {
+    next_block = block;
+    block_generate_new();
+    for (uint8_t i = 0; i < rows_down; i++) {
+        block_move_down();
+    }
+}
+
+static void setup_nearly_full_well(void) {
+    well_reset();
+    well_fill_with_holes(4);
+    block_spawn(BLOCK_TYPE_T, 0);
+}
+
+static void setup_four_full_lines(void) {
+    setup_nearly_full_well();
+    for (uint8_t i = ARRAY_SIZE(framebuffers.old_blocks) - 4;
+         i < ARRAY_SIZE(framebuffers.old_blocks); i++) {
+        framebuffers.old_blocks[i] = PLAYFIELD_MASK;
+    }
+}
+
+static void setup_t_block_in_open_well(void) {
+    well_reset();
+    block_spawn(BLOCK_TYPE_T, 10);
+}
+
+static void run_block_fits_down(void) {
+    block_fits(current_block.rotation, current_block.x, current_block.y + 1);
+}
+
+static void run_block_landing_y(void) {
+    block_landing_y(current_block.rows, current_block.rotation, current_block.x,
+                    current_block.y);
+}
+
+static void run_autoplay_plan(void) {
+    autoplay_plan();
+}
+
+static void run_delete_full_levels(void) {
+    delete_full_levels();
+}
+
+static void run_block_rotate(void) {
+    block_rotate();
+}
+
+const bench_case_t bench_tetris_cases[] = {
+        {"block_fits/down in nearly full well", setup_nearly_full_well,
+         run_block_fits_down, 100},
+        {"block_landing_y/nearly full well", setup_nearly_full_well,
+         run_block_landing_y, 100},
+        {"delete_full_levels/no full line", setup_nearly_full_well,
+         run_delete_full_levels, 200},
+        {"delete_full_levels/four full lines", setup_four_full_lines,
+         run_delete_full_levels, 250},
+        {"autoplay_plan/T over nearly full well", setup_nearly_full_well,
+         run_autoplay_plan, 10000},
+        {"block_rotate/T in open well", setup_t_block_in_open_well,
+         run_block_rotate, 150},
+};
+const size_t bench_tetris_cases_count = ARRAY_SIZE(bench_tetris_cases);
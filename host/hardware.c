@@ -0,0 +1,383 @@
+#include <avr/io.h>
+
+#include "host.h"
+
+/*
+ * Peripheral models. The SPI data register feeds a 48-bit model of the
+ * column/row shift register chain and the latch pin on PB2 copies it to the
+ * simulated LED matrix, so the display shows exactly what the firmware sends.
+ *
+ * A byte reaches the chain as soon as it is written, but the CPU time is
+ * charged as on the target: the transfer takes 8 shift clocks at the SPI or
+ * USART divider, a status poll waits until the byte it polls for is out,
+ * the USART buffer empty interrupt comes when the buffer really empties,
+ * and every interrupt pays for saving and restoring its registers.
+ */
+
+// avr-gcc saves every call-clobbered register in an interrupt that calls
+// functions, and only the few it uses in one that does not
+#define HOST_TIMER1_ISR_SAVE_CYCLES 40
+#define HOST_USART_UDRE_ISR_SAVE_CYCLES 12
+
+void TIMER1_COMPA_vect(void) __attribute__((weak));
+void PCINT1_vect(void) __attribute__((weak));
+void USART_UDRE_vect(void) __attribute__((weak));
+
+volatile uint8_t host_reg_DDRB;
+volatile uint8_t host_reg_PINC = 0x0f; // buttons are pulled up
+volatile uint8_t host_reg_SPCR;
+volatile uint8_t host_reg_PCICR;
+volatile uint8_t host_reg_PCMSK1;
+volatile uint8_t host_reg_TCCR1A;
+volatile uint8_t host_reg_TCCR1B;
+volatile uint8_t host_reg_TIMSK1;
+volatile uint8_t host_reg_DDRD;
+volatile uint8_t host_reg_UCSR0B;
+volatile uint8_t host_reg_UCSR0C;
+volatile uint16_t host_reg_UBRR0;
+
+static const uint8_t BUTTON_PINS[_HOST_BUTTON_COUNT] = {
+        [HOST_BUTTON_RIGHT] = PC0,
+        [HOST_BUTTON_LEFT] = PC2,
+        [HOST_BUTTON_UP] = PC1,
+        [HOST_BUTTON_DOWN] = PC3};
+
+static struct {
+    uint8_t portb;
+    bool latch_level;
+    uint8_t spdr;
+    bool spdr_written;
+    uint8_t spsr;
+    // when the byte last written to SPDR is out
+    uint64_t done_cycles;
+    uint64_t shift_register;
+    uint16_t display[HOST_DISPLAY_ROWS];
+    uint16_t dimmed[HOST_DISPLAY_ROWS];
+    uint32_t frames;
+    // on-time of each column of the row shown since row_since_cycles
+    int8_t lit_row;
+    uint16_t lit_columns;
+    uint64_t lit_since_cycles;
+    uint64_t row_since_cycles;
+    uint64_t column_cycles[16];
+} spi = {.lit_row = -1};
+
+static struct {
+    uint8_t ucsr0a;
+    // when the last byte written to UDR0 is out
+    uint64_t done_cycles;
+} usart;
+
+/*
+ * Timer1 in CTC mode. The counter restarts at each compare match, but the
+ * interrupt may be entered up to holdoff_max cycles later, as it would be
+ * behind interrupts disabled by the firmware or by other interrupts, and
+ * later still when another interrupt is running. OCR1A is not buffered: a
+ * top written below the count is only matched after the counter wrapped
+ * around.
+ */
+static struct {
+    bool running;
+    uint64_t last_match_cycles;
+    uint16_t ocr1a;
+    // count at the last OCR1A access, the interrupt's last one is its write
+    uint16_t ocr1a_access_tcnt;
+    uint16_t tcnt;
+    bool wrapped;
+    uint32_t holdoff_cycles;
+    uint32_t holdoff_max;
+    uint32_t holdoff_random;
+} timer1 = {.holdoff_random = 0x2545f491};
+
+static void spi_shift_pending_byte(void) {
+    if (spi.spdr_written) {
+        spi.shift_register = (spi.shift_register << 8) | spi.spdr;
+        spi.spdr_written = false;
+    }
+}
+
+// a row can be latched several times with different columns (one bit-plane
+// each), so it is only shown once the scan moved on to the next row. Its
+// pixels are dimmed when they were on for less than half of the row time.
+static void spi_row_finish(uint64_t now) {
+    uint64_t row_cycles = now - spi.row_since_cycles;
+    uint16_t lit = 0;
+    uint16_t dimmed = 0;
+
+    for (uint8_t col = 0; col < 16; col++) {
+        if (spi.column_cycles[col]) {
+            lit |= 1 << col;
+            if (spi.column_cycles[col] * 2 < row_cycles) {
+                dimmed |= 1 << col;
+            }
+        }
+        spi.column_cycles[col] = 0;
+    }
+    spi.display[spi.lit_row] = lit;
+    spi.dimmed[spi.lit_row] = dimmed;
+    spi.row_since_cycles = now;
+}
+
+static void spi_latch(void) {
+    uint16_t columns = ~(uint16_t)(spi.shift_register >> 32);
+    uint32_t row_select = (uint32_t) spi.shift_register;
+    uint64_t now = host_clock_cycles();
+
+    if (row_select == 0) {
+        return;
+    }
+
+    uint8_t row = __builtin_clz(row_select);
+    if (spi.lit_row >= 0) {
+        for (uint8_t col = 0; col < 16; col++) {
+            if (spi.lit_columns & (1 << col)) {
+                spi.column_cycles[col] += now - spi.lit_since_cycles;
+            }
+        }
+        if (row != spi.lit_row) {
+            spi_row_finish(now);
+        }
+    }
+    if (row != spi.lit_row && row == HOST_DISPLAY_ROWS - 1) {
+        spi.frames++;
+    }
+    spi.lit_row = row;
+    spi.lit_columns = columns;
+    spi.lit_since_cycles = now;
+}
+
+volatile uint8_t *host_reg_portb(void) {
+    bool level = spi.portb & _BV(PB2);
+
+    spi_shift_pending_byte();
+    if (level && !spi.latch_level) {
+        spi_latch();
+    }
+    spi.latch_level = level;
+
+    return &spi.portb;
+}
+
+static volatile uint8_t *shift_register_data(void) {
+    spi_shift_pending_byte();
+    spi.spdr_written = true;
+
+    return &spi.spdr;
+}
+
+// fosc/4 up to fosc/128 from SPR1:SPR0, halved by SPI2X
+static uint32_t spi_divider(void) {
+    static const uint8_t SPR_DIVIDERS[4] = {4, 16, 64, 128};
+
+    return SPR_DIVIDERS[SPCR & (_BV(SPR1) | _BV(SPR0))]
+           >> ((spi.spsr & _BV(SPI2X)) ? 1 : 0);
+}
+
+volatile uint8_t *host_reg_spdr(void) {
+    spi.done_cycles = host_clock_cycles() + 8 * spi_divider();
+
+    return shift_register_data();
+}
+
+volatile uint8_t *host_reg_spsr(void) {
+    // the firmware polls SPIF until the byte is out
+    uint64_t now = host_clock_cycles();
+    if (now < spi.done_cycles) {
+        host_clock_spend(spi.done_cycles - now);
+    }
+    spi_shift_pending_byte();
+    spi.spsr |= _BV(SPIF);
+
+    return &spi.spsr;
+}
+
+// fosc / (2 * (UBRR0 + 1)) in master SPI mode
+static uint32_t usart_byte_cycles(void) {
+    return 8 * 2 * ((uint32_t) UBRR0 + 1);
+}
+
+// the buffer empties when its byte moves on to the shifter, so once only
+// the last byte written is left
+static uint64_t usart_udre_cycles(void) {
+    uint32_t byte_cycles = usart_byte_cycles();
+
+    return usart.done_cycles > byte_cycles ? usart.done_cycles - byte_cycles
+                                           : 0;
+}
+
+volatile uint8_t *host_reg_ucsr0a(void) {
+    // the firmware polls UDRE0 until the buffer is free. TXC0 is cleared by
+    // the row driver before each row, so it stands for an idle shifter.
+    uint64_t now = host_clock_cycles();
+    uint64_t udre_cycles = usart_udre_cycles();
+    if (now < udre_cycles) {
+        host_clock_spend(udre_cycles - now);
+        now = host_clock_cycles();
+    }
+    usart.ucsr0a = _BV(UDRE0);
+    if (now >= usart.done_cycles) {
+        usart.ucsr0a |= _BV(TXC0);
+    }
+
+    return &usart.ucsr0a;
+}
+
+volatile uint8_t *host_reg_udr0(void) {
+    uint64_t now = host_clock_cycles();
+    uint64_t start_cycles = usart.done_cycles > now ? usart.done_cycles : now;
+    usart.done_cycles = start_cycles + usart_byte_cycles();
+
+    return shift_register_data();
+}
+
+static uint32_t timer1_prescaler(void) {
+    switch (TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))) {
+    case 1:
+        return 1;
+    case 2:
+        return 8;
+    case 3:
+        return 64;
+    case 4:
+        return 256;
+    case 5:
+        return 1024;
+    default:
+        return 0;
+    }
+}
+
+static uint16_t timer1_count(void) {
+    uint32_t prescaler = timer1_prescaler();
+
+    if (timer1.running && prescaler) {
+        timer1.tcnt = (host_clock_cycles() - timer1.last_match_cycles)
+                      / prescaler;
+    }
+
+    return timer1.tcnt;
+}
+
+volatile uint16_t *host_reg_ocr1a(void) {
+    timer1.ocr1a_access_tcnt = timer1_count();
+
+    return &timer1.ocr1a;
+}
+
+volatile uint16_t *host_reg_tcnt1(void) {
+    timer1_count();
+
+    return &timer1.tcnt;
+}
+
+void host_hardware_set_irq_holdoff(uint32_t max_cycles) {
+    timer1.holdoff_max = max_cycles;
+}
+
+// xorshift, so every run holds the interrupts off the same way
+static uint32_t timer1_holdoff_next(void) {
+    if (!timer1.holdoff_max) {
+        return 0;
+    }
+
+    timer1.holdoff_random ^= timer1.holdoff_random << 13;
+    timer1.holdoff_random ^= timer1.holdoff_random >> 17;
+    timer1.holdoff_random ^= timer1.holdoff_random << 5;
+
+    return timer1.holdoff_random % (timer1.holdoff_max + 1);
+}
+
+static uint64_t timer1_next_match(uint32_t prescaler) {
+    uint32_t top = (timer1.wrapped ? 0x10000 : 0) + (uint32_t) timer1.ocr1a + 1;
+
+    return timer1.last_match_cycles + (uint64_t) top * prescaler;
+}
+
+static uint64_t timer1_next_irq(void) {
+    uint32_t prescaler = timer1_prescaler();
+
+    if (!(TIMSK1 & _BV(OCIE1A)) || !prescaler || !TIMER1_COMPA_vect) {
+        timer1.running = false;
+        return HOST_NO_EVENT;
+    }
+    if (!timer1.running) {
+        timer1.running = true;
+        timer1.last_match_cycles = host_clock_cycles();
+        timer1.wrapped = false;
+        timer1.holdoff_cycles = timer1_holdoff_next();
+    }
+
+    return timer1_next_match(prescaler) + timer1.holdoff_cycles;
+}
+
+static uint64_t usart_next_irq(void) {
+    if (!(UCSR0B & _BV(UDRIE0)) || !USART_UDRE_vect) {
+        return HOST_NO_EVENT;
+    }
+
+    return usart_udre_cycles();
+}
+
+uint64_t host_hardware_next_event(void) {
+    uint64_t next = timer1_next_irq();
+    uint64_t usart_next = usart_next_irq();
+
+    return usart_next < next ? usart_next : next;
+}
+
+static void isr_run(void (*vector)(void), uint32_t save_cycles) {
+    host_clock_spend(save_cycles);
+    vector();
+    host_clock_spend(save_cycles);
+}
+
+static void timer1_isr_run(void) {
+    timer1.last_match_cycles = timer1_next_match(timer1_prescaler());
+    timer1.wrapped = false;
+    isr_run(TIMER1_COMPA_vect, HOST_TIMER1_ISR_SAVE_CYCLES);
+    // the new top is compared from the moment it was written
+    timer1.wrapped = timer1.ocr1a_access_tcnt > timer1.ocr1a;
+    timer1.holdoff_cycles = timer1_holdoff_next();
+}
+
+void host_hardware_run_until(uint64_t cycles) {
+    while (1) {
+        // interrupts that came due while another one ran are entered in
+        // priority order once it returns
+        uint64_t now = host_clock_cycles();
+        uint64_t until = cycles > now ? cycles : now;
+        if (timer1_next_irq() <= until) {
+            timer1_isr_run();
+        } else if (usart_next_irq() <= until) {
+            isr_run(USART_UDRE_vect, HOST_USART_UDRE_ISR_SAVE_CYCLES);
+        } else {
+            break;
+        }
+    }
+}
+
+void host_hardware_button_set(host_button_t button, bool pushed) {
+    uint8_t pin = BUTTON_PINS[button];
+
+    if (pushed) {
+        PINC &= ~_BV(pin);
+    } else {
+        PINC |= _BV(pin);
+    }
+
+    if ((PCICR & _BV(PCIE1)) && (PCMSK1 & _BV(pin)) && PCINT1_vect) {
+        PCINT1_vect();
+    }
+}
+
+const uint16_t *host_hardware_display(void) {
+    return spi.display;
+}
+
+const uint16_t *host_hardware_display_dimmed(void) {
+    return spi.dimmed;
+}
+
+uint32_t host_hardware_frames(void) {
+    return spi.frames;
+}
@@ -0,0 +1,42 @@
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HOST_DISPLAY_ROWS 32
+#define HOST_NO_EVENT UINT64_MAX
+
+typedef enum {
+    HOST_BUTTON_RIGHT,
+    HOST_BUTTON_LEFT,
+    HOST_BUTTON_UP,
+    HOST_BUTTON_DOWN,
+    _HOST_BUTTON_COUNT
+} host_button_t;
+
+// virtual clock, counted in CPU cycles since reset
+uint64_t host_clock_cycles(void);
+// charges CPU time taken by an interrupt or a busy wait in one, tasks only
+// spend time in avrtos delays
+void host_clock_spend(uint64_t cycles);
+
+// deepest use of a task's host stack, in host (not AVR) bytes
+uint8_t host_tasks_count(void);
+size_t host_task_stack_high_water(uint8_t id);
+
+uint64_t host_hardware_next_event(void);
+void host_hardware_run_until(uint64_t cycles);
+// enters each Timer1 interrupt up to max_cycles after its compare match
+void host_hardware_set_irq_holdoff(uint32_t max_cycles);
+void host_hardware_button_set(host_button_t button, bool pushed);
+const uint16_t *host_hardware_display(void);
+// pixels that were on for less than half of their row's scan time
+const uint16_t *host_hardware_display_dimmed(void);
+uint32_t host_hardware_frames(void);
+
+uint64_t host_sim_next_event(void);
+void host_sim_run_until(uint64_t cycles);
+
+#endif /* HOST_H_ */
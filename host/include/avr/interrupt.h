@@ -0,0 +1,14 @@
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+/*
+ * Interrupt service routines become plain functions which hardware.c calls
+ * whenever the modelled peripheral raises the interrupt.
+ */
+
+#define ISR(vector) void vector(void)
+
+#define sei()
+#define cli()
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
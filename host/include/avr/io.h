@@ -0,0 +1,110 @@
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+/*
+ * Host stand-in for <avr/io.h>. Only the ATmega328p registers used by the
+ * gametoy sources are modelled. Plain registers are ordinary variables, the
+ * ones with side effects (SPI/USART data and status, latch port, Timer1
+ * compare and counter) are routed through accessors in hardware.c.
+ */
+
+#include <inttypes.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t host_reg_DDRB;
+extern volatile uint8_t host_reg_PINC;
+extern volatile uint8_t host_reg_SPCR;
+extern volatile uint8_t host_reg_PCICR;
+extern volatile uint8_t host_reg_PCMSK1;
+extern volatile uint8_t host_reg_TCCR1A;
+extern volatile uint8_t host_reg_TCCR1B;
+extern volatile uint8_t host_reg_TIMSK1;
+extern volatile uint8_t host_reg_DDRD;
+extern volatile uint8_t host_reg_UCSR0B;
+extern volatile uint8_t host_reg_UCSR0C;
+extern volatile uint16_t host_reg_UBRR0;
+
+volatile uint8_t *host_reg_portb(void);
+volatile uint8_t *host_reg_spdr(void);
+volatile uint8_t *host_reg_spsr(void);
+volatile uint16_t *host_reg_ocr1a(void);
+volatile uint16_t *host_reg_tcnt1(void);
+volatile uint8_t *host_reg_ucsr0a(void);
+volatile uint8_t *host_reg_udr0(void);
+
+#define DDRB host_reg_DDRB
+#define PINC host_reg_PINC
+#define SPCR host_reg_SPCR
+#define PCICR host_reg_PCICR
+#define PCMSK1 host_reg_PCMSK1
+#define TCCR1A host_reg_TCCR1A
+#define TCCR1B host_reg_TCCR1B
+#define TIMSK1 host_reg_TIMSK1
+#define DDRD host_reg_DDRD
+#define UCSR0B host_reg_UCSR0B
+#define UCSR0C host_reg_UCSR0C
+#define UBRR0 host_reg_UBRR0
+
+#define PORTB (*host_reg_portb())
+#define SPDR (*host_reg_spdr())
+#define SPSR (*host_reg_spsr())
+#define OCR1A (*host_reg_ocr1a())
+#define TCNT1 (*host_reg_tcnt1())
+#define UCSR0A (*host_reg_ucsr0a())
+// USART0 in master SPI mode drives the same shift register chain
+#define UDR0 (*host_reg_udr0())
+
+#define PB2 2
+#define PB3 3
+#define PB5 5
+
+#define PD1 1
+#define PD4 4
+
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+
+#define SPR0 0
+#define SPR1 1
+#define CPHA 2
+#define CPOL 3
+#define MSTR 4
+#define DORD 5
+#define SPE 6
+#define SPIE 7
+
+#define SPI2X 0
+#define WCOL 6
+#define SPIF 7
+
+#define PCIE1 1
+
+#define PCINT8 0
+#define PCINT9 1
+#define PCINT10 2
+#define PCINT11 3
+
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+
+#define OCIE1A 1
+
+#define UDRE0 5
+#define TXC0 6
+
+#define TXEN0 3
+#define UDRIE0 5
+
+#define UCPOL0 0
+#define UCPHA0 1
+#define UDORD0 2
+#define UMSEL00 6
+#define UMSEL01 7
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,15 @@
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <inttypes.h>
+
+/*
+ * The host has a single address space, so program memory data is ordinary
+ * read-only data.
+ */
+
+#define PROGMEM
+
+#define pgm_read_byte(addr) (*(const uint8_t *) (addr))
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
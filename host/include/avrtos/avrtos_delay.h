@@ -0,0 +1,15 @@
+#ifndef HOST_AVRTOS_DELAY_H_
+#define HOST_AVRTOS_DELAY_H_
+
+#include <inttypes.h>
+
+/*
+ * Delays suspend the calling task until the virtual clock reaches the wake up
+ * time; nothing ever waits on the host wall clock.
+ */
+
+void avrtos_delay_ms(uint32_t ms);
+void avrtos_delay_us(uint32_t us);
+uint64_t _avrtos_delay_get_microseconds(void);
+
+#endif /* HOST_AVRTOS_DELAY_H_ */
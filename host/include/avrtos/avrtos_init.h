@@ -0,0 +1,34 @@
+#ifndef HOST_AVRTOS_INIT_H_
+#define HOST_AVRTOS_INIT_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/*
+ * Deterministic stand-in for avrtos: tasks are cooperative coroutines that
+ * only switch inside avrtos_delay_*(), so every run with the same input
+ * script produces the same output.
+ */
+
+#define AVRTOS_MINIMAL_STACK_SIZE 128
+
+typedef struct {
+    uint8_t id;
+} avrtos_task_t;
+
+typedef void avrtos_task_function_t(void *arg);
+
+#define AVRTOS_TASK_DEFINE(Name) avrtos_task_t Name
+#define AVRTOS_STACK_DEFINE(Name, Size) uint8_t Name[Size]
+
+#define AVRTOS_NON_PREEMPTIVE_SECTION() \
+    for (uint8_t _host_section = 1; _host_section; _host_section = 0)
+
+int avrtos_task_create(avrtos_task_t *task,
+                       avrtos_task_function_t *function,
+                       uint8_t *stack,
+                       size_t stack_size,
+                       void *arg);
+void avrtos_scheduler_start(void);
+
+#endif /* HOST_AVRTOS_INIT_H_ */
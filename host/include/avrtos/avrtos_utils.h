@@ -0,0 +1,7 @@
+#ifndef HOST_AVRTOS_UTILS_H_
+#define HOST_AVRTOS_UTILS_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#endif /* HOST_AVRTOS_UTILS_H_ */
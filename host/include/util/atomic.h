@@ -0,0 +1,17 @@
+#ifndef HOST_UTIL_ATOMIC_H_
+#define HOST_UTIL_ATOMIC_H_
+
+#include <inttypes.h>
+
+/*
+ * Interrupts are only dispatched while every task sleeps, so any block of
+ * code is already atomic on the host.
+ */
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#define ATOMIC_BLOCK(type) \
+    for (uint8_t _host_atomic = 1; _host_atomic; _host_atomic = 0)
+
+#endif /* HOST_UTIL_ATOMIC_H_ */
@@ -0,0 +1,397 @@
+#include <ctype.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buttons.h"
+#include "display.h"
+#include "gametoy.h"
+#include "snake.h"
+#include "spi.h"
+#include "tetris.h"
+
+#include "host.h"
+
+/*
+ * Headless gametoy simulator.
+ *
+ * Runs the unmodified game sources on a virtual clock, injects button presses
+ * from a script and renders the LED matrix, as decoded from the SPI stream,
+ * on an ANSI terminal (or as plain text with -a, where dimmed pixels show as
+ * "+").
+ *
+ * Script format: whitespace or comma separated "<time_ms><button>" entries,
+ * where button is one of R, L, U or D, e.g. "100R 400U 410U 900D". A script
+ * starting with '@' is read from the named file instead.
+ *
+ * With -l the row interrupt is entered up to the given number of
+ * microseconds late, and with -j the run fails when the row to row interval
+ * spread (max - min, in Timer1 ticks) goes over the given bound, or when the
+ * scan fell more than 1% behind its refresh rate (a stalled row shows up
+ * there, not in the intervals).
+ */
+
+#define CYCLES_PER_MS (F_CPU / 1000UL)
+#define CYCLES_PER_US (F_CPU / 1000000UL)
+#define SIM_BUTTON_PRESS_MS 40
+#define SIM_EVENTS_MAX 4096
+
+typedef struct {
+    uint64_t cycles;
+    host_button_t button;
+    bool pushed;
+} sim_event_t;
+
+static struct {
+    uint64_t duration_cycles;
+    uint64_t render_period_cycles;
+    bool plain;
+    bool quiet;
+    bool stats;
+    bool stacks;
+    uint32_t holdoff_us;
+    long jitter_max_ticks;
+} options = {
+        .jitter_max_ticks = -1,
+        .duration_cycles = 10000 * CYCLES_PER_MS,
+};
+
+static sim_event_t events[SIM_EVENTS_MAX];
+static size_t events_count;
+static size_t events_next;
+static uint64_t next_render_cycles;
+static struct timespec wall_start;
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-t duration_ms] [-s script] [-r render_period_ms] "
+            "[-a] [-q] [-d] [-k] [-l holdoff_us] [-j jitter_ticks]\n",
+            name);
+    exit(EXIT_FAILURE);
+}
+
+static int event_compare(const void *a, const void *b) {
+    const sim_event_t *ea = a;
+    const sim_event_t *eb = b;
+
+    if (ea->cycles != eb->cycles) {
+        return ea->cycles < eb->cycles ? -1 : 1;
+    }
+    return (int) eb->pushed - (int) ea->pushed;
+}
+
+static char *read_file(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *buffer = calloc(1, size + 1);
+    if (!buffer || fread(buffer, 1, size, file) != (size_t) size) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+
+    return buffer;
+}
+
+static void script_add(uint64_t ms, host_button_t button) {
+    if (events_count + 2 > SIM_EVENTS_MAX) {
+        fprintf(stderr, "sim: too many script events\n");
+        exit(EXIT_FAILURE);
+    }
+
+    events[events_count++] = (sim_event_t){
+            .cycles = ms * CYCLES_PER_MS, .button = button, .pushed = true};
+    events[events_count++] = (sim_event_t){
+            .cycles = (ms + SIM_BUTTON_PRESS_MS) * CYCLES_PER_MS,
+            .button = button,
+            .pushed = false};
+}
+
+static void script_parse(const char *script) {
+    char *buffer = script[0] == '@' ? read_file(script + 1) : strdup(script);
+    char *save;
+
+    for (char *token = strtok_r(buffer, " ,\t\r\n", &save); token;
+         token = strtok_r(NULL, " ,\t\r\n", &save)) {
+        char *end;
+        unsigned long ms = strtoul(token, &end, 10);
+        host_button_t button;
+
+        switch (toupper((unsigned char) *end)) {
+        case 'R':
+            button = HOST_BUTTON_RIGHT;
+            break;
+        case 'L':
+            button = HOST_BUTTON_LEFT;
+            break;
+        case 'U':
+            button = HOST_BUTTON_UP;
+            break;
+        case 'D':
+            button = HOST_BUTTON_DOWN;
+            break;
+        default:
+            fprintf(stderr, "sim: bad script entry '%s'\n", token);
+            exit(EXIT_FAILURE);
+        }
+        if (end == token || end[1] != '\0') {
+            fprintf(stderr, "sim: bad script entry '%s'\n", token);
+            exit(EXIT_FAILURE);
+        }
+        script_add(ms, button);
+    }
+
+    free(buffer);
+    qsort(events, events_count, sizeof(events[0]), event_compare);
+}
+
+static void render(void) {
+    const uint16_t *display = host_hardware_display();
+    const uint16_t *dimmed = host_hardware_display_dimmed();
+
+    const char *on = options.plain ? "#" : "\x1b[41m  \x1b[0m";
+    const char *dim = options.plain ? "+" : "\x1b[48;5;52m  \x1b[0m";
+    const char *off = options.plain ? "." : "  ";
+
+    if (!options.plain) {
+        printf("\x1b[H\x1b[2J");
+    }
+    for (uint8_t row = 0; row < HOST_DISPLAY_ROWS; row++) {
+        for (int8_t col = 15; col >= 0; col--) {
+            if (!((display[row] >> col) & 1)) {
+                fputs(off, stdout);
+            } else {
+                fputs((dimmed[row] >> col) & 1 ? dim : on, stdout);
+            }
+        }
+        putchar('\n');
+    }
+    printf("t = %" PRIu64 " ms\n", host_clock_cycles() / CYCLES_PER_MS);
+    fflush(stdout);
+}
+
+#if DISPLAY_STATS
+// row interval bounds over the whole run, every read starts a new period
+static uint16_t run_row_interval_min = UINT16_MAX;
+static uint16_t run_row_interval_max;
+static uint64_t run_frames;
+static uint64_t run_period_us;
+
+static void stats_read(display_stats_t *stats) {
+    display_stats_read(stats);
+    run_frames += stats->frames;
+    run_period_us += stats->period_us;
+    if (!stats->frames) {
+        return;
+    }
+    if (stats->row_interval_min < run_row_interval_min) {
+        run_row_interval_min = stats->row_interval_min;
+    }
+    if (stats->row_interval_max > run_row_interval_max) {
+        run_row_interval_max = stats->row_interval_max;
+    }
+}
+#endif
+
+static void stats_dump(void) {
+#if DISPLAY_STATS
+    display_stats_t stats;
+    stats_read(&stats);
+
+    fprintf(stderr,
+            "display: %" PRIu16 " Hz at SPI fosc/%" PRIu8 ", %" PRIu16
+            " frames in %" PRIu32 " us (%" PRIu16 " fps)\n",
+            stats.refresh_rate_hz, stats.spi_clock_divider, stats.frames,
+            stats.period_us, stats.frames_per_second);
+    fprintf(stderr,
+            "display: row interval min %" PRIu16 " max %" PRIu16
+            " mean %" PRIu16 " ticks, busy up to %" PRIu16
+            " ticks, %" PRIu16 " plane overruns\n",
+            stats.row_interval_min, stats.row_interval_max,
+            stats.row_interval_mean, stats.row_busy_max,
+            stats.plane_overruns);
+    fprintf(stderr, "display: row latency");
+    for (uint8_t i = 0; i < DISPLAY_STATS_LATENCY_BUCKETS; i++) {
+        fprintf(stderr, " %s%u:%" PRIu32,
+                i == DISPLAY_STATS_LATENCY_BUCKETS - 1 ? ">=" : "<",
+                (i + (i < DISPLAY_STATS_LATENCY_BUCKETS - 1))
+                        * DISPLAY_STATS_LATENCY_BUCKET_TICKS,
+                stats.row_latency_histogram[i]);
+    }
+    fputc('\n', stderr);
+#else
+    fprintf(stderr, "display: built without DISPLAY_STATS\n");
+#endif
+}
+
+// true when the row interval spread stayed within -j
+static bool jitter_check(void) {
+    if (options.jitter_max_ticks < 0) {
+        return true;
+    }
+#if DISPLAY_STATS
+    display_stats_t stats;
+    stats_read(&stats);
+
+    uint16_t jitter = run_row_interval_max - run_row_interval_min;
+    uint64_t expected_frames =
+            run_period_us * stats.refresh_rate_hz / 1000000;
+    bool ok = run_row_interval_min <= run_row_interval_max
+              && jitter <= options.jitter_max_ticks
+              && run_frames * 100 >= expected_frames * 99;
+    fprintf(stderr,
+            "jitter: row interval %" PRIu16 "..%" PRIu16
+            " ticks, spread %" PRIu16 " (bound %ld), %" PRIu64 " of %" PRIu64
+            " frames with up to %" PRIu32 " us hold-off: %s\n",
+            run_row_interval_min, run_row_interval_max, jitter,
+            options.jitter_max_ticks, run_frames, expected_frames,
+            options.holdoff_us, ok ? "ok" : "FAIL");
+
+    return ok;
+#else
+    fprintf(stderr, "jitter: built without DISPLAY_STATS\n");
+
+    return false;
+#endif
+}
+
+// the host runs every task on a large stack of its own, so the AVR control
+// thread stack keeps its paint and only the host numbers move
+static void stacks_dump(void) {
+    for (uint8_t i = 0; i < host_tasks_count(); i++) {
+        fprintf(stderr,
+                "stack: task %" PRIu8 " used at most %zu bytes of its x86-64"
+                " host stack, not an AVR measurement\n",
+                i, host_task_stack_high_water(i));
+    }
+    fprintf(stderr,
+            "stack: control thread AVR stack %" PRIu16 " of %" PRIu16
+            " bytes painted over, only meaningful on the board\n",
+            gametoy_control_stack_high_water(), gametoy_control_stack_size());
+}
+
+static void finish(void) {
+    struct timespec wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_s = (wall_end.tv_sec - wall_start.tv_sec)
+                    + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    uint32_t frames = host_hardware_frames();
+
+    if (!options.quiet) {
+        render();
+    }
+    if (options.stats) {
+        stats_dump();
+    }
+    if (options.stacks) {
+        stacks_dump();
+    }
+    bool jitter_ok = jitter_check();
+    fprintf(stderr,
+            "sim: %" PRIu64 " ms simulated, %" PRIu32
+            " frames scanned, %.3f s wall time (%.0f frames/s)\n",
+            host_clock_cycles() / CYCLES_PER_MS, frames, wall_s,
+            wall_s > 0 ? frames / wall_s : 0.0);
+    exit(jitter_ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+uint64_t host_sim_next_event(void) {
+    uint64_t next = options.duration_cycles;
+
+    if (events_next < events_count && events[events_next].cycles < next) {
+        next = events[events_next].cycles;
+    }
+    if (options.render_period_cycles && next_render_cycles < next) {
+        next = next_render_cycles;
+    }
+
+    return next;
+}
+
+void host_sim_run_until(uint64_t cycles) {
+    while (events_next < events_count
+           && events[events_next].cycles <= cycles) {
+        host_hardware_button_set(events[events_next].button,
+                                 events[events_next].pushed);
+        events_next++;
+    }
+
+    if (options.render_period_cycles && next_render_cycles <= cycles) {
+        render();
+        if (options.stats) {
+            stats_dump();
+        }
+        next_render_cycles += options.render_period_cycles;
+    }
+
+    if (cycles >= options.duration_cycles) {
+        finish();
+    }
+}
+
+int main(int argc, char **argv) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:s:r:aqdkl:j:")) != -1) {
+        switch (opt) {
+        case 't':
+            options.duration_cycles = strtoull(optarg, NULL, 10)
+                                      * CYCLES_PER_MS;
+            break;
+        case 's':
+            script_parse(optarg);
+            break;
+        case 'r':
+            options.render_period_cycles = strtoull(optarg, NULL, 10)
+                                           * CYCLES_PER_MS;
+            next_render_cycles = options.render_period_cycles;
+            break;
+        case 'a':
+            options.plain = true;
+            break;
+        case 'q':
+            options.quiet = true;
+            break;
+        case 'd':
+            options.stats = true;
+            break;
+        case 'k':
+            options.stacks = true;
+            break;
+        case 'l':
+            options.holdoff_us = strtoul(optarg, NULL, 10);
+            break;
+        case 'j':
+            options.jitter_max_ticks = strtol(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    host_hardware_set_irq_holdoff(options.holdoff_us * CYCLES_PER_US);
+
+    spi_master_init();
+    buttons_init();
+
+    tetris_game_install();
+    snake_game_install();
+
+    gametoy_start();
+
+    return EXIT_FAILURE;
+}
@@ -1,82 +1,94 @@
-#include <avr/interrupt.h>
-#include <avr/io.h>
-
-#include <util/atomic.h>
-
-#include "avrtos/avrtos_delay.h"
-
-#include "buttons.h"
-
-#define DEBOUNCE_VALUE_US (uint64_t) 150 * 1000
-
-#define PC0_PUSHED !(PINC & (1 << PC0))
-#define PC1_PUSHED !(PINC & (1 << PC1))
-#define PC2_PUSHED !(PINC & (1 << PC2))
-#define PC3_PUSHED !(PINC & (1 << PC3))
-
-#define RIGHT_BUTTON_PUSHED PC0_PUSHED
-#define LEFT_BUTTON_PUSHED PC2_PUSHED
-#define UP_BUTTON_PUSHED PC1_PUSHED
-#define DOWN_BUTTON_PUSHED PC3_PUSHED
-
-typedef struct {
-    uint64_t timestamp;
-    bool pushed;
-} button_state_t;
-
-static struct {
-    button_state_t right;
-    button_state_t left;
-    button_state_t up;
-    button_state_t down;
-} buttons_state;
-
-void buttons_init() {
-    PCICR |= _BV(PCIE1);
-
-    PCMSK1 |= _BV(PCINT8);
-    PCMSK1 |= _BV(PCINT9);
-    PCMSK1 |= _BV(PCINT10);
-    PCMSK1 |= _BV(PCINT11);
-}
-
-#define BUTTONS_PUSHED_DEFINE(Direction)                \
-    bool buttons_##Direction##_pushed() {               \
-        bool ret = false;                               \
-        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {             \
-            if (buttons_state.Direction.pushed) {       \
-                ret = true;                             \
-                buttons_state.Direction.pushed = false; \
-            }                                           \
-        }                                               \
-        return ret;                                     \
-    }
-
-BUTTONS_PUSHED_DEFINE(right);
-BUTTONS_PUSHED_DEFINE(left);
-BUTTONS_PUSHED_DEFINE(up);
-BUTTONS_PUSHED_DEFINE(down);
-
-#undef BUTTONS_PUSHED_DEFINE
-
-ISR(PCINT1_vect) {
-    uint64_t current_us = _avrtos_delay_get_microseconds();
-
-#define BUTTON_DEBOUNCE_DEFINE(Direction, ButtonPushed)          \
-    do {                                                         \
-        if (ButtonPushed && !buttons_state.Direction.pushed) {   \
-            if ((current_us - buttons_state.Direction.timestamp) \
-                > DEBOUNCE_VALUE_US) {                           \
-                buttons_state.Direction.pushed = true;           \
-                buttons_state.Direction.timestamp = current_us;  \
-            }                                                    \
-        }                                                        \
-    } while (0)
-
-    BUTTON_DEBOUNCE_DEFINE(right, RIGHT_BUTTON_PUSHED);
-    BUTTON_DEBOUNCE_DEFINE(left, LEFT_BUTTON_PUSHED);
-    BUTTON_DEBOUNCE_DEFINE(up, UP_BUTTON_PUSHED);
-    BUTTON_DEBOUNCE_DEFINE(down, DOWN_BUTTON_PUSHED);
-
-#undef BUTTON_DEBOUNCE_DEFINE
-}
+#include <avr/io.h>
+
+#include "avrtos/avrtos_delay.h"
+
+#include "buttons.h"
+#include "utils.h"
+
+// must be a power of two, so that the free running indices wrap cleanly
+#define BUTTONS_EVENTS_SIZE 8
+
+// keeps the compiler from moving the event write past the index update
+#define BUTTONS_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+#define BUTTONS_PINS_MASK (_BV(PC0) | _BV(PC1) | _BV(PC2) | _BV(PC3))
+
+static const buttons_button_t PIN_BUTTONS[] = {
+        [PC0] = BUTTONS_RIGHT,
+        [PC1] = BUTTONS_UP,
+        [PC2] = BUTTONS_LEFT,
+        [PC3] = BUTTONS_DOWN};
+
+// debounced pressed state per pin and a 2-bit counter per pin kept across
+// two bytes (a vertical counter), so all pins are debounced at once
+static uint8_t buttons_pressed;
+static uint8_t buttons_count_low;
+static uint8_t buttons_count_high;
+
+// single producer (the ISR) and single consumer (the control thread) ring,
+// each side only writes its own index and both fit in one byte, so neither
+// side needs to disable interrupts
+static buttons_event_t buttons_events[BUTTONS_EVENTS_SIZE];
+static volatile uint8_t buttons_events_head; // written by the ISR
+static volatile uint8_t buttons_events_tail; // written by the consumer
+
+void buttons_init() {
+    buttons_pressed = ~PINC & BUTTONS_PINS_MASK;
+    buttons_count_low = 0xff;
+    buttons_count_high = 0xff;
+}
+
+bool buttons_event_get(buttons_event_t *event) {
+    uint8_t tail = buttons_events_tail;
+    if (tail == buttons_events_head) {
+        return false;
+    }
+
+    BUTTONS_MEMORY_BARRIER();
+    *event = buttons_events[tail & (BUTTONS_EVENTS_SIZE - 1)];
+    BUTTONS_MEMORY_BARRIER();
+    buttons_events_tail = tail + 1;
+
+    return true;
+}
+
+bool buttons_event_pending(void) {
+    return buttons_events_tail != buttons_events_head;
+}
+
+static void buttons_event_put(buttons_button_t button, bool pressed,
+                              uint32_t current_us) {
+    uint8_t head = buttons_events_head;
+    if ((uint8_t)(head - buttons_events_tail) == BUTTONS_EVENTS_SIZE) {
+        // the consumer is behind, the newest event is dropped
+        return;
+    }
+
+    buttons_events[head & (BUTTONS_EVENTS_SIZE - 1)] = (buttons_event_t){
+            .timestamp_us = current_us,
+            .button = button,
+            .pressed = pressed};
+    BUTTONS_MEMORY_BARRIER();
+    buttons_events_head = head + 1;
+}
+
+void buttons_sample(void) {
+    // the counter of a pin that reads like its debounced state is reset,
+    // the others count down and the state toggles when one wraps around
+    uint8_t changed = (buttons_pressed ^ ~PINC) & BUTTONS_PINS_MASK;
+    buttons_count_low = ~(buttons_count_low & changed);
+    buttons_count_high = buttons_count_low ^ (buttons_count_high & changed);
+    changed &= buttons_count_low & buttons_count_high;
+    if (!changed) {
+        return;
+    }
+
+    buttons_pressed ^= changed;
+    uint32_t current_us = (uint32_t) _avrtos_delay_get_microseconds();
+    for (uint8_t pin = 0; changed; pin++, changed >>= 1) {
+        if (changed & 1) {
+            buttons_event_put(PIN_BUTTONS[pin], buttons_pressed & _BV(pin),
+                              current_us);
+        }
+    }
+}
@@ -1,12 +1,43 @@
-#ifndef BUTTONS_H_
-#define BUTTONS_H_
-
-#include <stdbool.h>
-
-void buttons_init(void);
-bool buttons_right_pushed();
-bool buttons_left_pushed();
-bool buttons_up_pushed();
-bool buttons_down_pushed();
-
-#endif /* BUTTONS_H_ */
+#ifndef BUTTONS_H_
+#define BUTTONS_H_
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+/*
+ * A button has to read the same for four consecutive samples before its
+ * state changes, so the samples are taken every BUTTONS_DEBOUNCE_MS / 4.
+ */
+#ifndef BUTTONS_DEBOUNCE_MS
+#define BUTTONS_DEBOUNCE_MS 20
+#endif
+#define BUTTONS_SAMPLE_PERIOD_US (BUTTONS_DEBOUNCE_MS * 1000UL / 4)
+
+typedef enum {
+    BUTTONS_RIGHT,
+    BUTTONS_LEFT,
+    BUTTONS_UP,
+    BUTTONS_DOWN,
+    _BUTTONS_COUNT
+} buttons_button_t;
+
+typedef struct {
+    uint32_t timestamp_us; // wraps around every ~71 minutes
+    buttons_button_t button : 7;
+    bool pressed : 1;
+} buttons_event_t;
+
+void buttons_init(void);
+
+// debounces the pins, to be called every BUTTONS_SAMPLE_PERIOD_US from an ISR
+void buttons_sample(void);
+
+/*
+ * Takes the oldest press or release event off the queue filled by
+ * buttons_sample(). Returns false when there is none. Must only be called
+ * from one thread.
+ */
+bool buttons_event_get(buttons_event_t *event);
+bool buttons_event_pending(void);
+
+#endif /* BUTTONS_H_ */
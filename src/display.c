@@ -0,0 +1,493 @@
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include <stddef.h>
+
+#include <util/atomic.h>
+
+#include "avrtos/avrtos_delay.h"
+
+#include "buttons.h"
+#include "display.h"
+#include "gametoy.h"
+#include "spi.h"
+
+#define DISPLAY_TIMER_PRESCALER 8
+#define DISPLAY_TIMER_TICKS_PER_SECOND (F_CPU / DISPLAY_TIMER_PRESCALER)
+#define DISPLAY_ROW_PERIOD_TICKS(RefreshRateHz) \
+    (DISPLAY_TIMER_TICKS_PER_SECOND / (RefreshRateHz) / GAMETOY_DISPLAY_SIZE)
+
+// shifting one row out takes SPI_ROW_BITS shift clocks, with half as much
+// again as slack for the interrupt
+#define DISPLAY_PLANE_MIN_TICKS(SpiClockDivider) \
+    (SPI_ROW_BITS * (SpiClockDivider) * 3 / 2 / DISPLAY_TIMER_PRESCALER)
+
+// the low plane of the 2 bit-plane mode gets a third of the row
+#if DISPLAY_ROW_PERIOD_TICKS(DISPLAY_REFRESH_RATE_HZ) / 3 \
+        < DISPLAY_PLANE_MIN_TICKS(SPI_CLOCK_DIVIDER)
+#error "DISPLAY_REFRESH_RATE_HZ is too high for SPI_CLOCK_DIVIDER"
+#endif
+#if DISPLAY_ROW_PERIOD_TICKS(DISPLAY_REFRESH_RATE_HZ) > 0xffff
+#error "DISPLAY_REFRESH_RATE_HZ is too low"
+#endif
+
+// a plane whose top was already passed ends this many ticks from now
+#define DISPLAY_PLANE_OVERRUN_TICKS 2
+
+// how long the scan runs at each setting while calibrating
+#define DISPLAY_CALIBRATION_PERIOD_MS 500
+
+// the row timer also paces the button sampling
+#define DISPLAY_BUTTONS_SAMPLE_TICKS                 \
+    (BUTTONS_SAMPLE_PERIOD_US * (DISPLAY_TIMER_TICKS_PER_SECOND / 1000000))
+
+// the scan shows the framebuffer or, without one, the layers composed row by
+// row
+static uint16_t *display_framebuffer;
+static const display_layer_t *display_layers;
+static uint8_t display_layers_count;
+static uint8_t display_depth;
+static const uint16_t *display_plane_ticks;
+static volatile bool display_pending;
+static uint16_t *display_pending_framebuffer;
+static const display_layer_t *display_pending_layers;
+static uint8_t display_pending_layers_count;
+static uint8_t display_pending_depth;
+static uint8_t display_row;
+static uint8_t display_plane;
+static uint8_t display_buttons_sample_rows;
+
+// frames between toggles of each blink rate, 0 when it does not blink
+static uint16_t display_blink_toggle_ms[DISPLAY_BLINK_RATES];
+static uint16_t display_blink_frames[DISPLAY_BLINK_RATES];
+static uint16_t display_blink_countdown[DISPLAY_BLINK_RATES];
+static uint8_t display_blink_off;
+
+static uint16_t display_refresh_rate_hz;
+static uint16_t display_row_period_ticks;
+static uint8_t display_buttons_sample_period_rows;
+// on-time of each plane by depth, every line adds up to the row period
+static uint16_t display_plane_ticks_by_depth[DISPLAY_DEPTH_MAX]
+                                            [DISPLAY_DEPTH_MAX];
+
+#if DISPLAY_STATS
+static struct {
+    uint64_t since_us;
+    uint16_t frames;
+    uint32_t rows;
+    uint16_t row_interval_min;
+    uint16_t row_interval_max;
+    uint16_t since_latency;
+    uint16_t latency;
+    uint16_t row_busy_max;
+    uint16_t plane_overruns;
+    uint32_t row_latency_histogram[DISPLAY_STATS_LATENCY_BUCKETS];
+} display_stats;
+
+static void display_stats_reset(void) {
+    display_stats.since_us = _avrtos_delay_get_microseconds();
+    display_stats.frames = 0;
+    display_stats.rows = 0;
+    display_stats.row_interval_min = UINT16_MAX;
+    display_stats.row_interval_max = 0;
+    display_stats.row_busy_max = 0;
+    display_stats.plane_overruns = 0;
+    display_stats.since_latency = display_stats.latency;
+    for (uint8_t i = 0; i < DISPLAY_STATS_LATENCY_BUCKETS; i++) {
+        display_stats.row_latency_histogram[i] = 0;
+    }
+}
+
+// TCNT1 restarts from 0 on the compare match, so at interrupt entry it holds
+// how long the interrupt was held off
+static inline void display_stats_row(uint16_t latency) {
+    // the planes of a row add up to the row period, so rows are timed from
+    // the first plane of one to the first plane of the next
+    if (display_plane == 0) {
+        uint16_t interval = display_row_period_ticks + latency
+                            - display_stats.latency;
+        display_stats.latency = latency;
+        display_stats.rows++;
+
+        if (interval < display_stats.row_interval_min) {
+            display_stats.row_interval_min = interval;
+        }
+        if (interval > display_stats.row_interval_max) {
+            display_stats.row_interval_max = interval;
+        }
+    }
+
+    uint16_t bucket = latency / DISPLAY_STATS_LATENCY_BUCKET_TICKS;
+    if (bucket >= DISPLAY_STATS_LATENCY_BUCKETS) {
+        bucket = DISPLAY_STATS_LATENCY_BUCKETS - 1;
+    }
+    display_stats.row_latency_histogram[bucket]++;
+}
+
+// TCNT1 when the interrupt is done with the row
+static inline void display_stats_row_done(uint16_t busy) {
+    if (busy > display_stats.row_busy_max) {
+        display_stats.row_busy_max = busy;
+    }
+}
+
+void display_stats_read(display_stats_t *stats) {
+    uint64_t now_us = _avrtos_delay_get_microseconds();
+    uint64_t since_us;
+    uint16_t since_latency;
+    uint16_t latency;
+    uint32_t rows;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        since_us = display_stats.since_us;
+        rows = display_stats.rows;
+        since_latency = display_stats.since_latency;
+        latency = display_stats.latency;
+        stats->frames = display_stats.frames;
+        stats->row_interval_min = display_stats.row_interval_min;
+        stats->row_interval_max = display_stats.row_interval_max;
+        stats->row_busy_max = display_stats.row_busy_max;
+        stats->plane_overruns = display_stats.plane_overruns;
+        stats->refresh_rate_hz = display_refresh_rate_hz;
+        stats->spi_clock_divider = spi_master_clock_divider();
+        for (uint8_t i = 0; i < DISPLAY_STATS_LATENCY_BUCKETS; i++) {
+            stats->row_latency_histogram[i] =
+                    display_stats.row_latency_histogram[i];
+        }
+        display_stats_reset();
+    }
+
+    // the intervals add up to whole periods plus the change in latency
+    stats->period_us = now_us - since_us;
+    stats->frames_per_second =
+            stats->period_us
+                    ? ((uint64_t) stats->frames * 1000000 + stats->period_us / 2)
+                              / stats->period_us
+                    : 0;
+    stats->row_interval_mean =
+            rows ? display_row_period_ticks
+                           + ((int32_t) latency - since_latency) / (int32_t) rows
+                 : 0;
+    if (!rows) {
+        stats->row_interval_min = 0;
+    }
+}
+#endif
+
+static uint16_t display_compose_row(uint8_t row, uint8_t plane) {
+    uint8_t plane_bit = 1 << plane;
+    uint16_t columns = 0;
+    uint16_t blanked = 0;
+
+    for (uint8_t i = 0; i < display_layers_count; i++) {
+        const display_layer_t *layer = &display_layers[i];
+        uint8_t layer_row = row - layer->first_row;
+        if (layer_row >= layer->row_count || !(layer->planes & plane_bit)) {
+            continue;
+        }
+        uint16_t bits = layer->mask;
+        if (layer->rows) {
+            bits |= layer->rows[layer_row];
+        }
+        if (layer->blink & display_blink_off) {
+            blanked |= bits;
+        } else {
+            columns |= bits;
+        }
+    }
+
+    return columns & ~blanked;
+}
+
+static uint16_t display_blink_toggle_frames(uint16_t toggle_ms,
+                                            uint16_t refresh_rate_hz) {
+    if (!toggle_ms) {
+        return 0;
+    }
+
+    uint32_t frames = ((uint32_t) toggle_ms * refresh_rate_hz + 500) / 1000;
+    if (frames < 1) {
+        frames = 1;
+    }
+    if (frames > 0xffff) {
+        frames = 0xffff;
+    }
+
+    return frames;
+}
+
+// runs once per frame, so blinking costs the control thread nothing
+static void display_blink_frame(void) {
+    for (uint8_t i = 0; i < DISPLAY_BLINK_RATES; i++) {
+        if (display_blink_frames[i] && --display_blink_countdown[i] == 0) {
+            display_blink_countdown[i] = display_blink_frames[i];
+            display_blink_off ^= DISPLAY_LAYER_BLINK(i);
+        }
+    }
+}
+
+static void display_shift_row(uint8_t row, uint8_t plane) {
+    uint16_t columns;
+    if (display_framebuffer) {
+        columns = display_framebuffer[plane * GAMETOY_DISPLAY_SIZE + row];
+    } else {
+        columns = display_compose_row(row, plane);
+    }
+
+    spi_master_tx_row(~columns, row);
+}
+
+static bool display_row_period_fits(uint16_t row_period_ticks,
+                                    uint16_t plane_min_ticks) {
+    return row_period_ticks / 3 >= plane_min_ticks;
+}
+
+static void display_set_row_period(uint16_t refresh_rate_hz,
+                                   uint16_t row_period_ticks) {
+    uint32_t sample_rows = DISPLAY_BUTTONS_SAMPLE_TICKS / row_period_ticks;
+    if (sample_rows < 1) {
+        sample_rows = 1;
+    }
+    if (sample_rows > 0xff) {
+        sample_rows = 0xff;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        display_refresh_rate_hz = refresh_rate_hz;
+        display_row_period_ticks = row_period_ticks;
+        display_buttons_sample_period_rows = sample_rows;
+        display_buttons_sample_rows = 0;
+        display_plane_ticks_by_depth[0][0] = row_period_ticks;
+        display_plane_ticks_by_depth[1][0] = row_period_ticks / 3;
+        display_plane_ticks_by_depth[1][1] = row_period_ticks
+                                             - row_period_ticks / 3;
+        // the blink rates keep their period at the new refresh rate
+        for (uint8_t i = 0; i < DISPLAY_BLINK_RATES; i++) {
+            display_blink_frames[i] = display_blink_toggle_frames(
+                    display_blink_toggle_ms[i], refresh_rate_hz);
+            if (display_blink_countdown[i] > display_blink_frames[i]) {
+                display_blink_countdown[i] = display_blink_frames[i];
+            }
+        }
+    }
+}
+
+bool display_configure(uint8_t spi_clock_divider, uint16_t refresh_rate_hz) {
+    if (refresh_rate_hz == 0
+        || !spi_master_clock_divider_valid(spi_clock_divider)) {
+        return false;
+    }
+
+    uint32_t row_period_ticks = DISPLAY_ROW_PERIOD_TICKS(refresh_rate_hz);
+    if (row_period_ticks > 0xffff
+        || !display_row_period_fits(row_period_ticks,
+                                    DISPLAY_PLANE_MIN_TICKS(spi_clock_divider))) {
+        return false;
+    }
+
+    // a slower clock must be running before the rows get shorter and
+    // vice versa, so that a row always shifts out in time
+    if (row_period_ticks >= display_row_period_ticks) {
+        display_set_row_period(refresh_rate_hz, row_period_ticks);
+    }
+    spi_master_set_clock_divider(spi_clock_divider);
+    display_set_row_period(refresh_rate_hz, row_period_ticks);
+
+    return true;
+}
+
+uint16_t display_refresh_rate(void) {
+    return display_refresh_rate_hz;
+}
+
+#if DISPLAY_STATS
+// lets the scan run with the current setting and reads what it managed
+static void display_calibration_measure(display_stats_t *stats) {
+    display_stats_read(stats);
+    avrtos_delay_ms(DISPLAY_CALIBRATION_PERIOD_MS);
+    display_stats_read(stats);
+}
+
+bool display_calibrate(uint8_t fastest_divider, uint16_t max_refresh_rate_hz) {
+    uint8_t divider = spi_master_clock_divider();
+    uint16_t refresh_rate_hz = display_refresh_rate_hz;
+    display_stats_t stats;
+
+    for (uint16_t candidate = SPI_CLOCK_DIVIDER_MIN;
+         candidate <= SPI_CLOCK_DIVIDER_MAX; candidate *= 2) {
+        if (candidate < fastest_divider) {
+            continue;
+        }
+
+        // the interrupt's own time per row is measured at the current
+        // refresh rate, the shift itself may outlast it with the USART
+        if (!display_configure(candidate, refresh_rate_hz)) {
+            continue;
+        }
+        display_calibration_measure(&stats);
+        uint16_t plane_min_ticks = DISPLAY_PLANE_MIN_TICKS(candidate);
+        if ((uint32_t) stats.row_busy_max * 3 / 2 > plane_min_ticks) {
+            plane_min_ticks = (uint32_t) stats.row_busy_max * 3 / 2;
+        }
+
+        uint32_t fastest_hz = DISPLAY_TIMER_TICKS_PER_SECOND
+                              / ((uint32_t) plane_min_ticks * 3
+                                 * GAMETOY_DISPLAY_SIZE);
+        if (fastest_hz > max_refresh_rate_hz) {
+            fastest_hz = max_refresh_rate_hz;
+        }
+        if (!display_configure(candidate, fastest_hz)) {
+            continue;
+        }
+
+        // stable means every frame made it and no row ran a quarter late
+        display_calibration_measure(&stats);
+        if ((uint32_t) stats.frames_per_second * 100 >= fastest_hz * 99
+            && stats.row_interval_max
+                       <= display_row_period_ticks
+                                  + display_row_period_ticks / 4) {
+            return true;
+        }
+    }
+
+    display_configure(divider, refresh_rate_hz);
+
+    return false;
+}
+#endif
+
+void display_init(uint16_t *framebuffer) {
+    display_set_row_period(DISPLAY_REFRESH_RATE_HZ,
+                           DISPLAY_ROW_PERIOD_TICKS(DISPLAY_REFRESH_RATE_HZ));
+
+    // without a framebuffer the scan starts out with no layers
+    display_framebuffer = framebuffer;
+    display_layers = NULL;
+    display_layers_count = 0;
+    display_depth = 1;
+    display_plane_ticks = display_plane_ticks_by_depth[0];
+    display_row = 0;
+    display_plane = 0;
+    display_shift_row(display_row, display_plane);
+
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM12) | _BV(CS11); // CTC on OCR1A, clk/8
+    OCR1A = display_row_period_ticks - 1;
+    TCNT1 = 0;
+    TIMSK1 |= _BV(OCIE1A);
+
+#if DISPLAY_STATS
+    display_stats_reset();
+#endif
+}
+
+void display_framebuffer_flip(uint16_t *framebuffer) {
+    display_framebuffer_flip_planes(framebuffer, 1);
+}
+
+void display_framebuffer_flip_planes(uint16_t *planes, uint8_t depth) {
+    if (depth < 1 || depth > DISPLAY_DEPTH_MAX) {
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        display_pending_framebuffer = planes;
+        display_pending_layers = NULL;
+        display_pending_depth = depth;
+        display_pending = true;
+    }
+}
+
+void display_layers_show(const display_layer_t *layers,
+                         uint8_t count,
+                         uint8_t depth) {
+    if (count > DISPLAY_LAYERS_MAX || depth < 1
+        || depth > DISPLAY_DEPTH_MAX) {
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        display_pending_framebuffer = NULL;
+        display_pending_layers = layers;
+        display_pending_layers_count = count;
+        display_pending_depth = depth;
+        display_pending = true;
+    }
+}
+
+void display_blink_set(uint8_t rate, uint16_t toggle_ms) {
+    if (rate >= DISPLAY_BLINK_RATES) {
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        display_blink_toggle_ms[rate] = toggle_ms;
+        display_blink_frames[rate] =
+                display_blink_toggle_frames(toggle_ms, display_refresh_rate_hz);
+        display_blink_countdown[rate] = display_blink_frames[rate];
+        display_blink_off &= ~DISPLAY_LAYER_BLINK(rate);
+    }
+}
+
+bool display_framebuffer_flip_pending(void) {
+    bool ret;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ret = display_pending;
+    }
+
+    return ret;
+}
+
+ISR(TIMER1_COMPA_vect) {
+#if DISPLAY_STATS
+    display_stats_row(TCNT1);
+#endif
+
+    // the plane was shifted out during the previous period, so latching it
+    // first thing keeps its on-time independent of the SPI transfer time
+    spi_latch_trigger();
+    // Timer1 already restarted from 0, the new top applies to this period
+    OCR1A = display_plane_ticks[display_plane] - 1;
+    // OCR1A is not buffered in CTC mode, so a top the count already passed
+    // would only match after Timer1 wrapped around, 32 ms later. The plane
+    // is cut short instead; writing TCNT1 would block the next match.
+    if (TCNT1 >= OCR1A) {
+        OCR1A = TCNT1 + DISPLAY_PLANE_OVERRUN_TICKS;
+#if DISPLAY_STATS
+        display_stats.plane_overruns++;
+#endif
+    }
+
+    if (++display_plane == display_depth) {
+        display_plane = 0;
+        display_row++;
+        if (display_row == GAMETOY_DISPLAY_SIZE) {
+            display_row = 0;
+#if DISPLAY_STATS
+            display_stats.frames++;
+#endif
+            display_blink_frame();
+            if (display_pending) {
+                display_framebuffer = display_pending_framebuffer;
+                display_layers = display_pending_layers;
+                display_layers_count = display_pending_layers_count;
+                display_depth = display_pending_depth;
+                display_plane_ticks =
+                        display_plane_ticks_by_depth[display_depth - 1];
+                display_pending = false;
+            }
+        }
+    }
+    display_shift_row(display_row, display_plane);
+
+    if (display_plane == 0
+        && ++display_buttons_sample_rows
+                   >= display_buttons_sample_period_rows) {
+        display_buttons_sample_rows = 0;
+        buttons_sample();
+    }
+
+#if DISPLAY_STATS
+    display_stats_row_done(TCNT1);
+#endif
+}
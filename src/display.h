@@ -0,0 +1,157 @@
+#ifndef DISPLAY_H_
+#define DISPLAY_H_
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+/*
+ * Full-frame refresh rate of the LED matrix after display_init(). Every row
+ * is shown for exactly 1 / (refresh rate * GAMETOY_DISPLAY_SIZE) seconds,
+ * timed by the Timer1 compare match interrupt.
+ */
+#ifndef DISPLAY_REFRESH_RATE_HZ
+#define DISPLAY_REFRESH_RATE_HZ 100
+#endif
+
+/*
+ * Scan statistics, counted by the row interrupt. Build with -DDISPLAY_STATS=0
+ * to take them out of the interrupt completely.
+ */
+#ifndef DISPLAY_STATS
+#define DISPLAY_STATS 1
+#endif
+
+/*
+ * Bit-planes per pixel the scan can show. Plane n of a depth deep framebuffer
+ * stays on for 2^n / (2^depth - 1) of the row period (binary code
+ * modulation), so 2 planes give 4 brightness levels.
+ */
+#define DISPLAY_DEPTH_MAX 2
+
+/*
+ * Builds with DISPLAY_CALIBRATE set run display_calibrate() at start up,
+ * trying no faster clock than fosc / DISPLAY_CALIBRATE_FASTEST_DIVIDER (for
+ * long cables) and no refresh rate above DISPLAY_CALIBRATE_MAX_HZ.
+ */
+#ifndef DISPLAY_CALIBRATE
+#define DISPLAY_CALIBRATE 0
+#endif
+#ifndef DISPLAY_CALIBRATE_FASTEST_DIVIDER
+#define DISPLAY_CALIBRATE_FASTEST_DIVIDER 2
+#endif
+#ifndef DISPLAY_CALIBRATE_MAX_HZ
+#define DISPLAY_CALIBRATE_MAX_HZ 200
+#endif
+
+#if DISPLAY_CALIBRATE && !DISPLAY_STATS
+#error "DISPLAY_CALIBRATE measures the scan with DISPLAY_STATS"
+#endif
+
+#if DISPLAY_STATS
+// how long the row interrupt was held off, in Timer1 ticks (0.5 us at 16 MHz)
+#define DISPLAY_STATS_LATENCY_BUCKETS 8
+#define DISPLAY_STATS_LATENCY_BUCKET_TICKS 16
+
+typedef struct {
+    uint32_t period_us;
+    uint16_t frames;
+    uint16_t frames_per_second;
+    // row to row interval in Timer1 ticks
+    uint16_t row_interval_min;
+    uint16_t row_interval_max;
+    uint16_t row_interval_mean;
+    // latency plus the time the interrupt took for the row, in Timer1 ticks
+    uint16_t row_busy_max;
+    // planes entered after their top had passed, ended early instead
+    uint16_t plane_overruns;
+    // the setting the scan ran with
+    uint16_t refresh_rate_hz;
+    uint8_t spi_clock_divider;
+    // row interrupts (one per bit-plane) by latency, the last bucket also
+    // counts anything longer
+    uint32_t row_latency_histogram[DISPLAY_STATS_LATENCY_BUCKETS];
+} display_stats_t;
+
+/*
+ * Fills stats with the counts since the previous call (or display_init())
+ * and starts a new measurement period.
+ */
+void display_stats_read(display_stats_t *stats);
+
+/*
+ * Tries the SPI clock dividers from fastest_divider up, each at the highest
+ * refresh rate up to max_refresh_rate_hz that its measured row time allows,
+ * and keeps the first one the scan sustains with no late rows. Sleeps while
+ * measuring, so it is called from a task. Restores the previous setting and
+ * returns false when none was stable.
+ */
+bool display_calibrate(uint8_t fastest_divider, uint16_t max_refresh_rate_hz);
+#endif
+
+/*
+ * Sets the SPI clock to fosc / spi_clock_divider and the refresh rate. Fails
+ * and keeps the current setting if a row of the 2 bit-plane mode would not
+ * shift out in time, or if the rate does not fit the 16-bit row timer.
+ */
+bool display_configure(uint8_t spi_clock_divider, uint16_t refresh_rate_hz);
+uint16_t display_refresh_rate(void);
+
+/*
+ * A layer lights row_count rows from first_row on with the given row bits
+ * (if rows is set) ORed with mask. The scan composes each row from the
+ * layers right before sending it, so changes to a layer or to its rows show
+ * up from the next scanned row on.
+ *
+ * A layer with blink set is an attribute on its pixels: while the blink rate
+ * is in its off phase those pixels stay dark, whatever other layer lights
+ * them.
+ */
+#define DISPLAY_LAYERS_MAX 8
+
+// bit-planes lit by a layer, dimmed ones show at a third of the brightness
+#define DISPLAY_LAYER_FULL 0x03
+#define DISPLAY_LAYER_DIMMED 0x01
+
+#define DISPLAY_BLINK_RATES 4
+#define DISPLAY_LAYER_BLINK(Rate) (1 << (Rate))
+
+typedef struct {
+    const uint16_t *rows;
+    uint8_t first_row;
+    uint8_t row_count;
+    uint16_t mask;
+    uint8_t planes;
+    uint8_t blink;
+} display_layer_t;
+
+// framebuffer may be NULL to start with no layers
+void display_init(uint16_t *framebuffer);
+
+/*
+ * Queues the framebuffer to be scanned starting with the next frame. The
+ * previous framebuffer stays on the display until the scan wraps to row 0,
+ * so it must not be modified while display_framebuffer_flip_pending().
+ */
+void display_framebuffer_flip(uint16_t *framebuffer);
+/*
+ * Same for a framebuffer of depth bit-planes of GAMETOY_DISPLAY_SIZE rows
+ * each, least significant plane first.
+ */
+void display_framebuffer_flip_planes(uint16_t *planes, uint8_t depth);
+/*
+ * Switches the scan over to count layers of the array, shown with depth
+ * bit-planes, from the next frame on. The array stays in use until the next
+ * display_framebuffer_flip() or display_layers_show().
+ */
+void display_layers_show(const display_layer_t *layers,
+                         uint8_t count,
+                         uint8_t depth);
+bool display_framebuffer_flip_pending(void);
+
+/*
+ * Toggles the layers blinking at rate every toggle_ms, counted in scanned
+ * frames, starting in the on phase. A toggle_ms of 0 keeps them on.
+ */
+void display_blink_set(uint8_t rate, uint16_t toggle_ms);
+
+#endif /* DISPLAY_H_ */
@@ -1,248 +1,447 @@
-#include <avr/io.h>
-
-#include "avrtos/avrtos_delay.h"
-#include "avrtos/avrtos_init.h"
-
-#include "buttons.h"
-#include "gametoy.h"
-#include "spi.h"
-#include "utils.h"
-#include "welcome_screen.h"
-
-AVRTOS_TASK_DEFINE(display_task);
-AVRTOS_STACK_DEFINE(display_thread_stack, AVRTOS_MINIMAL_STACK_SIZE);
-AVRTOS_TASK_DEFINE(control_task);
-AVRTOS_STACK_DEFINE(control_thread_stack, AVRTOS_MINIMAL_STACK_SIZE + 50);
-
-static gametoy_actions_t *game_actions[_GAME_TYPE_COUNT] = {};
-static game_type_t current_game_type = GAME_TYPE_NONE;
-static bool game_started = false;
-
-static uint16_t gametoy_framebuffer[GAMETOY_DISPLAY_SIZE];
-
-const static uint8_t DIGITS_BITMAP[10][5] = {
-        [0] = {0b11100000, 0b10100000, 0b10100000, 0b10100000, 0b11100000},
-        [1] = {0b01000000, 0b11000000, 0b01000000, 0b01000000, 0b11100000},
-        [2] = {0b11100000, 0b00100000, 0b11100000, 0b10000000, 0b11100000},
-        [3] = {0b11100000, 0b00100000, 0b11100000, 0b00100000, 0b11100000},
-        [4] = {0b10100000, 0b10100000, 0b11100000, 0b00100000, 0b00100000},
-        [5] = {0b11100000, 0b10000000, 0b11100000, 0b00100000, 0b11100000},
-        [6] = {0b11100000, 0b10000000, 0b11100000, 0b10100000, 0b11100000},
-        [7] = {0b11100000, 0b10100000, 0b00100000, 0b00100000, 0b00100000},
-        [8] = {0b11100000, 0b10100000, 0b11100000, 0b10100000, 0b11100000},
-        [9] = {0b11100000, 0b10100000, 0b11100000, 0b00100000, 0b11100000}};
-
-static void display_thread(void *_arg) {
-    (void) _arg;
-
-    static uint8_t iterator_spi;
-
-    while (1) {
-        AVRTOS_NON_PREEMPTIVE_SECTION() {
-            spi_master_tx_16bits_blocking(~gametoy_framebuffer[iterator_spi]);
-            spi_master_tx_32bits_blocking(0x80000000 >> iterator_spi);
-            spi_latch_trigger();
-
-            iterator_spi++;
-            if (iterator_spi == GAMETOY_DISPLAY_SIZE) {
-                iterator_spi = 0;
-            }
-        }
-
-        avrtos_delay_us(300);
-    }
-}
-
-static void right_button_perform_action(void) {
-    if (!game_actions[current_game_type]) {
-        return;
-    }
-    if (game_actions[current_game_type]->right_button_action) {
-        game_actions[current_game_type]->right_button_action();
-    }
-}
-
-static void left_button_perform_action(void) {
-    if (!game_actions[current_game_type]) {
-        return;
-    }
-    if (game_actions[current_game_type]->left_button_action) {
-        game_actions[current_game_type]->left_button_action();
-    }
-}
-
-static void up_button_perform_action(void) {
-    if (!game_actions[current_game_type]) {
-        return;
-    }
-    if (game_actions[current_game_type]->up_button_action) {
-        game_actions[current_game_type]->up_button_action();
-    }
-}
-
-static void down_button_perform_action(void) {
-    if (!game_actions[current_game_type]) {
-        return;
-    }
-    if (game_actions[current_game_type]->down_button_action) {
-        game_actions[current_game_type]->down_button_action();
-    }
-}
-
-static bool periodic_action(uint32_t delay_ms) {
-    if (!game_actions[current_game_type]) {
-        return false;
-    }
-    if (game_actions[current_game_type]->right_button_action) {
-        return game_actions[current_game_type]->periodic_action(delay_ms);
-    }
-
-    return false;
-}
-
-static void update_gametoy_framebuffer(void) {
-    AVRTOS_NON_PREEMPTIVE_SECTION() {
-        if (!game_actions[current_game_type]) {
-            return;
-        }
-        if (game_actions[current_game_type]->update_gametoy_framebuffer) {
-            game_actions[current_game_type]->update_gametoy_framebuffer(
-                    gametoy_framebuffer);
-        }
-    }
-}
-
-static void initialize_game_one_time() {
-    if (!game_actions[current_game_type]) {
-        return;
-    }
-    if (game_actions[current_game_type]->initialize) {
-        game_actions[current_game_type]->initialize();
-    }
-}
-
-static void control_thread(void *_arg) {
-    (void) _arg;
-
-    static const uint64_t CONTROL_DELAY_MS = 15;
-
-    welcome_screen_initialize();
-    update_gametoy_framebuffer();
-
-    while (1) {
-        bool changed = false;
-        if (game_started) {
-            game_started = false;
-            uint16_t seed = (uint16_t) _avrtos_delay_get_microseconds();
-            srand(seed);
-            initialize_game_one_time();
-            update_gametoy_framebuffer();
-        }
-        if (buttons_right_pushed()) {
-            changed = true;
-            right_button_perform_action();
-        }
-        if (buttons_left_pushed()) {
-            changed = true;
-            left_button_perform_action();
-        }
-        if (buttons_up_pushed()) {
-            changed = true;
-            up_button_perform_action();
-        }
-        if (buttons_down_pushed()) {
-            changed = true;
-            down_button_perform_action();
-        }
-
-        if (periodic_action(CONTROL_DELAY_MS)) {
-            changed = true;
-        }
-
-        if (changed) {
-            changed = false;
-            update_gametoy_framebuffer();
-        }
-
-        avrtos_delay_ms(CONTROL_DELAY_MS);
-    }
-}
-
-void gametoy_start(void) {
-    welcome_screen_install();
-    if (avrtos_task_create(&display_task, display_thread, display_thread_stack,
-                           sizeof(display_thread_stack), NULL)) {
-        return;
-    }
-
-    if (avrtos_task_create(&control_task, control_thread, control_thread_stack,
-                           sizeof(control_thread_stack), NULL)) {
-        return;
-    }
-
-    avrtos_scheduler_start();
-}
-
-void gametoy_update_points_framebuffer(uint16_t *framebuffer, uint16_t points) {
-    uint8_t unity = points % 10;
-    uint8_t tens = (points % 100) / 10;
-    uint8_t hundreds = points / 100;
-
-    for (uint8_t i = 0; i < ARRAY_SIZE(DIGITS_BITMAP[0]); i++) {
-        framebuffer[i] |= (uint16_t)(DIGITS_BITMAP[hundreds][i]) << 8;
-        framebuffer[i] |= (uint16_t)(DIGITS_BITMAP[tens][i]) << 4;
-        framebuffer[i] |= (uint16_t)(DIGITS_BITMAP[unity][i]);
-    }
-}
-
-uint16_t gametoy_get_random_value(void) {
-    uint16_t ret;
-    AVRTOS_NON_PREEMPTIVE_SECTION() {
-        ret = rand();
-    }
-
-    return ret;
-}
-
-void gametoy_game_over(uint16_t points) {
-    for (uint8_t i = 0; i < GAMETOY_DISPLAY_SIZE; i++) {
-        AVRTOS_NON_PREEMPTIVE_SECTION() {
-            gametoy_framebuffer[i] = 0;
-        }
-        avrtos_delay_ms(100);
-    }
-    avrtos_delay_ms(900);
-
-    AVRTOS_NON_PREEMPTIVE_SECTION() {
-        gametoy_update_points_framebuffer(&gametoy_framebuffer[1], points);
-    }
-
-    while (1) {
-        avrtos_delay_ms(10000);
-    }
-}
-
-void gametoy_game_install(gametoy_actions_t *actions, game_type_t game_type) {
-    if (game_type == _GAME_TYPE_COUNT) {
-        return;
-    }
-
-    game_actions[game_type] = actions;
-}
-
-void gametoy_game_select(game_type_t game_type) {
-    if (game_type == _GAME_TYPE_COUNT || game_type == GAME_TYPE_NONE) {
-        return;
-    }
-
-    current_game_type = game_type;
-}
-
-void gametoy_game_run() {
-    if (current_game_type == _GAME_TYPE_COUNT
-        || current_game_type == GAME_TYPE_NONE) {
-        return;
-    }
-
-    game_started = true;
-}
+#include <avr/io.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/atomic.h>
+
+#include "avrtos/avrtos_delay.h"
+#include "avrtos/avrtos_init.h"
+
+#include "buttons.h"
+#include "display.h"
+#include "gametoy.h"
+#include "utils.h"
+#include "welcome_screen.h"
+
+// size it from the high water mark gametoy_control_stack_high_water() reads
+// on the target, plus a margin for the interrupts that run on the same stack
+#ifndef GAMETOY_CONTROL_STACK_SIZE
+#define GAMETOY_CONTROL_STACK_SIZE (AVRTOS_MINIMAL_STACK_SIZE + 50)
+#endif
+
+// the control thread sleeps through the game's timers, but never longer
+// than this, so a button press is handled within this time
+#ifndef GAMETOY_INPUT_LATENCY_MS
+#define GAMETOY_INPUT_LATENCY_MS 20
+#endif
+
+AVRTOS_TASK_DEFINE(control_task);
+AVRTOS_STACK_DEFINE(control_thread_stack, GAMETOY_CONTROL_STACK_SIZE);
+
+#define STACK_PAINT 0xa5
+
+static gametoy_actions_t *game_actions[_GAME_TYPE_COUNT] = {};
+static game_type_t current_game_type = GAME_TYPE_NONE;
+static bool game_started = false;
+static bool game_demo = false;
+
+// the final score, shown once the game over wipe cleared the game's layers
+static uint16_t game_over_points[5];
+static display_layer_t game_over_layers[] = {
+        {.rows = game_over_points,
+         .first_row = 1,
+         .row_count = ARRAY_SIZE(game_over_points),
+         .planes = DISPLAY_LAYER_FULL},
+};
+
+// pending timers sorted by deadline on the monotonic millisecond tick
+static gametoy_timer_t *gametoy_timers;
+static gametoy_timer_t *gametoy_timer_running;
+static uint32_t gametoy_time_ms;
+static gametoy_timer_t demo_timer;
+
+const static uint8_t DIGITS_BITMAP[10][5] = {
+        [0] = {0b11100000, 0b10100000, 0b10100000, 0b10100000, 0b11100000},
+        [1] = {0b01000000, 0b11000000, 0b01000000, 0b01000000, 0b11100000},
+        [2] = {0b11100000, 0b00100000, 0b11100000, 0b10000000, 0b11100000},
+        [3] = {0b11100000, 0b00100000, 0b11100000, 0b00100000, 0b11100000},
+        [4] = {0b10100000, 0b10100000, 0b11100000, 0b00100000, 0b00100000},
+        [5] = {0b11100000, 0b10000000, 0b11100000, 0b00100000, 0b11100000},
+        [6] = {0b11100000, 0b10000000, 0b11100000, 0b10100000, 0b11100000},
+        [7] = {0b11100000, 0b10100000, 0b00100000, 0b00100000, 0b00100000},
+        [8] = {0b11100000, 0b10100000, 0b11100000, 0b10100000, 0b11100000},
+        [9] = {0b11100000, 0b10100000, 0b11100000, 0b00100000, 0b11100000}};
+
+static void right_button_perform_action(void) {
+    if (!game_actions[current_game_type]) {
+        return;
+    }
+    if (game_actions[current_game_type]->right_button_action) {
+        game_actions[current_game_type]->right_button_action();
+    }
+}
+
+static void left_button_perform_action(void) {
+    if (!game_actions[current_game_type]) {
+        return;
+    }
+    if (game_actions[current_game_type]->left_button_action) {
+        game_actions[current_game_type]->left_button_action();
+    }
+}
+
+static void up_button_perform_action(void) {
+    if (!game_actions[current_game_type]) {
+        return;
+    }
+    if (game_actions[current_game_type]->up_button_action) {
+        game_actions[current_game_type]->up_button_action();
+    }
+}
+
+static void down_button_perform_action(void) {
+    if (!game_actions[current_game_type]) {
+        return;
+    }
+    if (game_actions[current_game_type]->down_button_action) {
+        game_actions[current_game_type]->down_button_action();
+    }
+}
+
+static void autoplay_perform_action(uint32_t elapsed_ms) {
+    if (!game_actions[current_game_type]
+        || !game_actions[current_game_type]->autoplay_action) {
+        return;
+    }
+
+    switch (game_actions[current_game_type]->autoplay_action(elapsed_ms)) {
+    case GAMETOY_BUTTON_RIGHT:
+        right_button_perform_action();
+        break;
+    case GAMETOY_BUTTON_LEFT:
+        left_button_perform_action();
+        break;
+    case GAMETOY_BUTTON_UP:
+        up_button_perform_action();
+        break;
+    case GAMETOY_BUTTON_DOWN:
+        down_button_perform_action();
+        break;
+    default:
+        break;
+    }
+}
+
+static void button_perform_action(buttons_button_t button) {
+    switch (button) {
+    case BUTTONS_RIGHT:
+        right_button_perform_action();
+        break;
+    case BUTTONS_LEFT:
+        left_button_perform_action();
+        break;
+    case BUTTONS_UP:
+        up_button_perform_action();
+        break;
+    case BUTTONS_DOWN:
+        down_button_perform_action();
+        break;
+    default:
+        break;
+    }
+}
+
+static bool timer_is_due(uint32_t deadline_ms) {
+    return (int32_t)(deadline_ms - gametoy_time_ms) <= 0;
+}
+
+static void timer_insert(gametoy_timer_t *timer) {
+    gametoy_timer_t **link = &gametoy_timers;
+    while (*link
+           && (int32_t)((*link)->deadline_ms - timer->deadline_ms) <= 0) {
+        link = &(*link)->next;
+    }
+    timer->next = *link;
+    *link = timer;
+}
+
+static void timers_clear(void) {
+    gametoy_timers = NULL;
+    gametoy_timer_running = NULL;
+}
+
+// runs the due timers, looking at the list head only when none is due
+static void timers_run(void) {
+    while (gametoy_timers && timer_is_due(gametoy_timers->deadline_ms)) {
+        gametoy_timer_t *timer = gametoy_timers;
+        gametoy_timers = timer->next;
+
+        gametoy_timer_running = timer;
+        timer->callback();
+        if (gametoy_timer_running != timer) {
+            // restarted or stopped by its callback
+            continue;
+        }
+        gametoy_timer_running = NULL;
+
+        if (timer->period_ms) {
+            timer->deadline_ms += timer->period_ms;
+            timer_insert(timer);
+        }
+    }
+}
+
+static uint32_t timers_next_ms(void) {
+    if (!gametoy_timers) {
+        return UINT32_MAX;
+    }
+    if (timer_is_due(gametoy_timers->deadline_ms)) {
+        return 0;
+    }
+
+    return gametoy_timers->deadline_ms - gametoy_time_ms;
+}
+
+static void demo_timer_callback(void) {
+    autoplay_perform_action(demo_timer.period_ms);
+}
+
+static void initialize_game_one_time() {
+    if (!game_actions[current_game_type]) {
+        return;
+    }
+    if (game_actions[current_game_type]->initialize) {
+        game_actions[current_game_type]->initialize();
+    }
+    display_layers_show(game_actions[current_game_type]->layers,
+                        game_actions[current_game_type]->layers_count, 2);
+}
+
+// hides the part of the layers down to and including row; the scan reads
+// the layers, so each one changes as a whole
+static void layers_clip_to_row(display_layer_t *layers,
+                               uint8_t count,
+                               uint8_t row) {
+    for (uint8_t i = 0; i < count; i++) {
+        display_layer_t *layer = &layers[i];
+        if (!layer->row_count || layer->first_row > row) {
+            continue;
+        }
+
+        uint8_t hidden = row + 1 - layer->first_row;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (hidden >= layer->row_count) {
+                layer->row_count = 0;
+            } else {
+                layer->first_row += hidden;
+                layer->row_count -= hidden;
+                if (layer->rows) {
+                    layer->rows += hidden;
+                }
+            }
+        }
+    }
+}
+
+// sleeps straight to the next timer deadline; avrtos has no primitive the
+// button ISR could release to wake the thread, so a long sleep is cut at
+// the longest a press may wait to be handled
+static void control_wait(uint32_t timeout_ms) {
+    if (timeout_ms > GAMETOY_INPUT_LATENCY_MS) {
+        timeout_ms = GAMETOY_INPUT_LATENCY_MS;
+    }
+    if (timeout_ms && !buttons_event_pending()) {
+        avrtos_delay_ms(timeout_ms);
+    }
+}
+
+static void control_thread(void *_arg) {
+    (void) _arg;
+
+    // the demo's button presses are paced by the game, poll it this often
+    static const uint32_t CONTROL_DEMO_PERIOD_MS = 15;
+
+#if DISPLAY_CALIBRATE
+    // the blank display scans for a few seconds while this runs
+    display_calibrate(DISPLAY_CALIBRATE_FASTEST_DIVIDER,
+                      DISPLAY_CALIBRATE_MAX_HZ);
+#endif
+
+    welcome_screen_initialize();
+    initialize_game_one_time();
+
+    uint64_t last_us = _avrtos_delay_get_microseconds();
+    while (1) {
+        // whole milliseconds only, the rest carries over to the next round;
+        // advanced first so timers started by the buttons or by a game's
+        // initialize count from now
+        uint32_t elapsed_ms =
+                (uint32_t)(_avrtos_delay_get_microseconds() - last_us) / 1000;
+        last_us += (uint64_t) elapsed_ms * 1000;
+        gametoy_time_ms += elapsed_ms;
+
+        buttons_event_t event;
+        while (buttons_event_get(&event)) {
+            if (!event.pressed) {
+                continue;
+            }
+            if (game_demo) {
+                // any press ends the demo and goes back to the welcome screen
+                game_demo = false;
+                current_game_type = GAME_TYPE_NONE;
+                timers_clear();
+                initialize_game_one_time();
+                continue;
+            }
+            button_perform_action(event.button);
+        }
+
+        // a game selected by a button or restarting after its demo ended
+        if (game_started) {
+            game_started = false;
+            srand((uint16_t) _avrtos_delay_get_microseconds());
+            timers_clear();
+            initialize_game_one_time();
+            if (game_demo) {
+                gametoy_timer_start(&demo_timer, CONTROL_DEMO_PERIOD_MS,
+                                    CONTROL_DEMO_PERIOD_MS,
+                                    demo_timer_callback);
+            }
+        }
+
+        timers_run();
+
+        // a demo that just ended restarts without waiting, its timers are
+        // all gone
+        control_wait(game_started ? 0 : timers_next_ms());
+    }
+}
+
+void gametoy_start(void) {
+    welcome_screen_install();
+    display_init(NULL);
+
+    memset(control_thread_stack, STACK_PAINT, sizeof(control_thread_stack));
+    if (avrtos_task_create(&control_task, control_thread, control_thread_stack,
+                           sizeof(control_thread_stack), NULL)) {
+        return;
+    }
+
+    avrtos_scheduler_start();
+}
+
+void gametoy_update_points_framebuffer(uint16_t *framebuffer, uint16_t points) {
+    uint8_t unity = points % 10;
+    uint8_t tens = (points % 100) / 10;
+    uint8_t hundreds = points / 100;
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(DIGITS_BITMAP[0]); i++) {
+        framebuffer[i] |= (uint16_t)(DIGITS_BITMAP[hundreds][i]) << 8;
+        framebuffer[i] |= (uint16_t)(DIGITS_BITMAP[tens][i]) << 4;
+        framebuffer[i] |= (uint16_t)(DIGITS_BITMAP[unity][i]);
+    }
+}
+
+uint16_t gametoy_get_random_value(void) {
+    uint16_t ret;
+    AVRTOS_NON_PREEMPTIVE_SECTION() {
+        ret = rand();
+    }
+
+    return ret;
+}
+
+void gametoy_game_over(uint16_t points) {
+    gametoy_actions_t *actions = game_actions[current_game_type];
+    for (uint8_t i = 0; i < GAMETOY_DISPLAY_SIZE; i++) {
+        layers_clip_to_row(actions->layers, actions->layers_count, i);
+        avrtos_delay_ms(100);
+    }
+    avrtos_delay_ms(900);
+
+    memset(game_over_points, 0, sizeof(game_over_points));
+    gametoy_update_points_framebuffer(game_over_points, points);
+    display_layers_show(game_over_layers, ARRAY_SIZE(game_over_layers), 2);
+
+    if (game_demo) {
+        // the demo plays on with a fresh game, nothing of this one may run
+        avrtos_delay_ms(3000);
+        timers_clear();
+        game_started = true;
+        return;
+    }
+
+    while (1) {
+        avrtos_delay_ms(10000);
+    }
+}
+
+void gametoy_game_install(gametoy_actions_t *actions, game_type_t game_type) {
+    if (game_type == _GAME_TYPE_COUNT) {
+        return;
+    }
+
+    game_actions[game_type] = actions;
+}
+
+void gametoy_game_select(game_type_t game_type) {
+    if (game_type == _GAME_TYPE_COUNT || game_type == GAME_TYPE_NONE) {
+        return;
+    }
+
+    current_game_type = game_type;
+}
+
+void gametoy_game_run() {
+    if (current_game_type == _GAME_TYPE_COUNT
+        || current_game_type == GAME_TYPE_NONE) {
+        return;
+    }
+
+    game_started = true;
+}
+
+void gametoy_game_run_demo() {
+    if (current_game_type == _GAME_TYPE_COUNT
+        || current_game_type == GAME_TYPE_NONE) {
+        return;
+    }
+    if (!game_actions[current_game_type]->autoplay_action) {
+        current_game_type = GAME_TYPE_NONE;
+        return;
+    }
+
+    game_demo = true;
+    game_started = true;
+}
+
+void gametoy_timer_start(gametoy_timer_t *timer,
+                         uint32_t delay_ms,
+                         uint32_t period_ms,
+                         gametoy_timer_callback_t *callback) {
+    gametoy_timer_stop(timer);
+    timer->deadline_ms = gametoy_time_ms + delay_ms;
+    timer->period_ms = period_ms;
+    timer->callback = callback;
+    timer_insert(timer);
+}
+
+void gametoy_timer_stop(gametoy_timer_t *timer) {
+    if (gametoy_timer_running == timer) {
+        gametoy_timer_running = NULL;
+    }
+
+    for (gametoy_timer_t **link = &gametoy_timers; *link;
+         link = &(*link)->next) {
+        if (*link == timer) {
+            *link = timer->next;
+            return;
+        }
+    }
+}
+
+uint16_t gametoy_control_stack_size(void) {
+    return sizeof(control_thread_stack);
+}
+
+uint16_t gametoy_control_stack_high_water(void) {
+    // the stack grows down, so the paint at the bottom is the last to go
+    uint16_t unused = 0;
+    while (unused < sizeof(control_thread_stack)
+           && control_thread_stack[unused] == STACK_PAINT) {
+        unused++;
+    }
+
+    return sizeof(control_thread_stack) - unused;
+}
@@ -1,43 +1,89 @@
-#ifndef GAMETOY_H_
-#define GAMETOY_H_
-
-#include <inttypes.h>
-#include <stdbool.h>
-
-#define GAMETOY_DISPLAY_SIZE 32
-
-typedef enum {
-    GAME_TYPE_NONE,
-    GAME_TYPE_SNAKE,
-    GAME_TYPE_TETRIS,
-    _GAME_TYPE_COUNT
-} game_type_t;
-
-typedef void gametoy_right_button_action_t(void);
-typedef void gametoy_left_button_action_t(void);
-typedef void gametoy_up_button_action_t(void);
-typedef void gametoy_down_button_action_t(void);
-typedef bool gametoy_periodic_action_t(uint32_t delay_ms);
-typedef void
-gametoy_update_gametoy_framebuffer_t(uint16_t *gametoy_framebuffer);
-typedef void gametoy_initialize_t(void);
-
-typedef struct {
-    gametoy_right_button_action_t *right_button_action;
-    gametoy_left_button_action_t *left_button_action;
-    gametoy_up_button_action_t *up_button_action;
-    gametoy_down_button_action_t *down_button_action;
-    gametoy_periodic_action_t *periodic_action;
-    gametoy_update_gametoy_framebuffer_t *update_gametoy_framebuffer;
-    gametoy_initialize_t *initialize;
-} gametoy_actions_t;
-
-void gametoy_start(void);
-uint16_t gametoy_get_random_value(void);
-void gametoy_update_points_framebuffer(uint16_t *framebuffer, uint16_t points);
-void gametoy_game_over(uint16_t points);
-void gametoy_game_install(gametoy_actions_t *actions, game_type_t game_type);
-void gametoy_game_select(game_type_t game);
-void gametoy_game_run(void);
-
-#endif /* GAMETOY_H_ */
+#ifndef GAMETOY_H_
+#define GAMETOY_H_
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "display.h"
+
+#define GAMETOY_DISPLAY_SIZE 32
+
+typedef enum {
+    GAME_TYPE_NONE,
+    GAME_TYPE_SNAKE,
+    GAME_TYPE_TETRIS,
+    _GAME_TYPE_COUNT
+} game_type_t;
+
+typedef enum {
+    GAMETOY_BUTTON_NONE,
+    GAMETOY_BUTTON_RIGHT,
+    GAMETOY_BUTTON_LEFT,
+    GAMETOY_BUTTON_UP,
+    GAMETOY_BUTTON_DOWN
+} gametoy_button_t;
+
+typedef void gametoy_right_button_action_t(void);
+typedef void gametoy_left_button_action_t(void);
+typedef void gametoy_up_button_action_t(void);
+typedef void gametoy_down_button_action_t(void);
+typedef void gametoy_initialize_t(void);
+// picks the button the demo presses next, or GAMETOY_BUTTON_NONE
+typedef gametoy_button_t gametoy_autoplay_action_t(uint32_t elapsed_ms);
+
+typedef void gametoy_timer_callback_t(void);
+
+/*
+ * Timers are owned by the game, usually as static variables. A periodic
+ * timer keeps its deadlines on the period grid, so a late round does not
+ * shift the following ones and missed periods are run to catch up. The
+ * callback may change period_ms, restart or stop its own timer. All timers
+ * are stopped whenever a game is started.
+ */
+typedef struct gametoy_timer {
+    struct gametoy_timer *next;
+    uint32_t deadline_ms;
+    uint32_t period_ms; // 0 for a one-shot timer
+    gametoy_timer_callback_t *callback;
+} gametoy_timer_t;
+
+typedef struct {
+    gametoy_right_button_action_t *right_button_action;
+    gametoy_left_button_action_t *left_button_action;
+    gametoy_up_button_action_t *up_button_action;
+    gametoy_down_button_action_t *down_button_action;
+    // shown while the game runs, the game keeps them up to date in place
+    display_layer_t *layers;
+    uint8_t layers_count;
+    gametoy_initialize_t *initialize;
+    gametoy_autoplay_action_t *autoplay_action;
+} gametoy_actions_t;
+
+void gametoy_start(void);
+uint16_t gametoy_get_random_value(void);
+void gametoy_update_points_framebuffer(uint16_t *framebuffer, uint16_t points);
+/*
+ * Wipes the display and shows the points. Outside the demo this never
+ * returns. In the demo it returns with the game ended and its timers
+ * stopped, and the caller must return right away without changing the game,
+ * which starts over through its initialize.
+ */
+void gametoy_game_over(uint16_t points);
+void gametoy_game_install(gametoy_actions_t *actions, game_type_t game_type);
+void gametoy_game_select(game_type_t game);
+void gametoy_game_run(void);
+void gametoy_game_run_demo(void);
+void gametoy_timer_start(gametoy_timer_t *timer,
+                         uint32_t delay_ms,
+                         uint32_t period_ms,
+                         gametoy_timer_callback_t *callback);
+void gametoy_timer_stop(gametoy_timer_t *timer);
+
+/*
+ * The control thread stack is painted before the task is created, so its high
+ * water mark counts the bytes that were ever overwritten since start up.
+ */
+uint16_t gametoy_control_stack_size(void);
+uint16_t gametoy_control_stack_high_water(void);
+
+#endif /* GAMETOY_H_ */
@@ -1,6 +1,6 @@
-#ifndef SNAKE_H_
-#define SNAKE_H_
-
-void snake_game_install(void);
-
-#endif /* SNAKE_H_ */
+#ifndef SNAKE_H_
+#define SNAKE_H_
+
+void snake_game_install(void);
+
+#endif /* SNAKE_H_ */
@@ -1,32 +1,160 @@
+#include <avr/interrupt.h>
 #include <avr/io.h>
 
+#include <util/atomic.h>
+
 #include "avrtos/avrtos_utils.h"
-
+
+#include "spi.h"
+
+// row select bit within its byte, bytes go out least significant bit first
+// and row 0 is the last bit of the chain
+static const uint8_t SPI_ROW_SELECT_BITS[8] = {0x80, 0x40, 0x20, 0x10,
+                                               0x08, 0x04, 0x02, 0x01};
+
+static uint8_t spi_clock_divider;
+
+#if SPI_DRIVER == SPI_DRIVER_SPI
+
+// SPR1:SPR0 and SPI2X for fosc/2 up to fosc/128
+static const struct {
+    uint8_t spcr;
+    uint8_t spsr;
+} SPI_CLOCK_BITS[7] = {
+        {0, _BV(SPI2X)},
+        {0, 0},
+        {_BV(SPR0), _BV(SPI2X)},
+        {_BV(SPR0), 0},
+        {_BV(SPR1), _BV(SPI2X)},
+        {_BV(SPR1), 0},
+        {_BV(SPR1) | _BV(SPR0), 0},
+};
+
 static inline void spi_master_tx_8bits_blocking(uint8_t data_byte) {
-    SPDR = data_byte;
-    while(!(SPSR & (1<<SPIF)))
+    SPDR = data_byte;
+    while(!(SPSR & (1<<SPIF)))
         ;
-}
-
-void spi_master_init(void) {
-    DDRB |= _BV(PB3);
-    DDRB |= _BV(PB5);
-    DDRB |= _BV(PB2);
-
-    SPCR |= _BV(DORD);
-    SPCR |= _BV(SPR0);
-    SPCR |= _BV(MSTR);
-    SPCR |= _BV(SPE);
-}
-
-void spi_master_tx_16bits_blocking(uint16_t data_bytes) {
-    uint8_t *data_bytes_ptr = (uint8_t *)&data_bytes;
-    spi_master_tx_8bits_blocking(data_bytes_ptr[1]);
-    spi_master_tx_8bits_blocking(data_bytes_ptr[0]);
-}
-
-void spi_master_tx_32bits_blocking(uint32_t data_bytes) {
-    uint16_t *data_bytes_ptr = (uint16_t *)&data_bytes;
-    spi_master_tx_16bits_blocking(data_bytes_ptr[1]);
-    spi_master_tx_16bits_blocking(data_bytes_ptr[0]);
-}
\ No newline at end of file
+}
+
+void spi_master_init(void) {
+    DDRB |= _BV(PB3);
+    DDRB |= _BV(PB5);
+    DDRB |= _BV(PB2);
+
+    SPCR |= _BV(DORD);
+    SPCR |= _BV(MSTR);
+    SPCR |= _BV(SPE);
+    spi_master_set_clock_divider(SPI_CLOCK_DIVIDER);
+}
+
+bool spi_master_set_clock_divider(uint8_t divider) {
+    if (!spi_master_clock_divider_valid(divider)) {
+        return false;
+    }
+
+    uint8_t index = __builtin_ctz(divider) - 1;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        SPCR = (SPCR & ~(_BV(SPR1) | _BV(SPR0))) | SPI_CLOCK_BITS[index].spcr;
+        SPSR = (SPSR & ~_BV(SPI2X)) | SPI_CLOCK_BITS[index].spsr;
+        spi_clock_divider = divider;
+    }
+
+    return true;
+}
+
+void spi_master_tx_row(uint16_t columns, uint8_t row) {
+    uint8_t row_byte = row >> 3;
+    uint8_t row_bit = SPI_ROW_SELECT_BITS[row & 7];
+
+    spi_master_tx_8bits_blocking(columns >> 8);
+    spi_master_tx_8bits_blocking(columns);
+    for (uint8_t i = 0; i < 4; i++) {
+        spi_master_tx_8bits_blocking(i == row_byte ? row_bit : 0);
+    }
+}
+
+#elif SPI_DRIVER == SPI_DRIVER_USART
+
+static uint8_t spi_tx_row_select[4];
+static volatile uint8_t spi_tx_index;
+// divider waiting for the shifter to drain, 0 when there is none
+static volatile uint8_t spi_clock_divider_pending;
+
+// the baud rate is fosc / (2 * (UBRR0 + 1)) in master SPI mode
+static inline void spi_usart_clock_divider_apply(void) {
+    UBRR0 = spi_clock_divider_pending / 2 - 1;
+    spi_clock_divider_pending = 0;
+}
+
+void spi_master_init(void) {
+    DDRB |= _BV(PB2);
+    DDRD |= _BV(PD1);
+    DDRD |= _BV(PD4);
+
+    // the baud rate has to be set after the transmitter is enabled
+    UBRR0 = 0;
+    UCSR0C = _BV(UMSEL01) | _BV(UMSEL00) | _BV(UDORD0);
+    UCSR0B = _BV(TXEN0);
+    spi_master_set_clock_divider(SPI_CLOCK_DIVIDER);
+    // nothing is shifting out yet
+    spi_usart_clock_divider_apply();
+}
+
+bool spi_master_set_clock_divider(uint8_t divider) {
+    if (!spi_master_clock_divider_valid(divider)) {
+        return false;
+    }
+
+    // UBRR0 must not change while a frame shifts out, so the row driver
+    // applies it between rows
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        spi_clock_divider_pending = divider;
+        spi_clock_divider = divider;
+    }
+
+    return true;
+}
+
+static inline void spi_usart_tx_8bits(uint8_t data_byte) {
+    while (!(UCSR0A & _BV(UDRE0)))
+        ;
+    UDR0 = data_byte;
+}
+
+void spi_master_tx_row(uint16_t columns, uint8_t row) {
+    for (uint8_t i = 0; i < sizeof(spi_tx_row_select); i++) {
+        spi_tx_row_select[i] = 0;
+    }
+    spi_tx_row_select[row >> 3] = SPI_ROW_SELECT_BITS[row & 7];
+
+    // the last row has drained once its select bytes were all fed and the
+    // shifter went idle, otherwise the new divider waits for the next row
+    if (spi_clock_divider_pending && !(UCSR0B & _BV(UDRIE0))
+        && (UCSR0A & _BV(TXC0))) {
+        spi_usart_clock_divider_apply();
+    }
+    // writing one clears the flag, it is set again when this row is out
+    UCSR0A |= _BV(TXC0);
+
+    // the first byte moves on to the shifter right away and the second one
+    // waits in the buffer, the interrupt feeds the row select behind them
+    spi_usart_tx_8bits(columns >> 8);
+    spi_usart_tx_8bits(columns);
+    spi_tx_index = 0;
+    UCSR0B |= _BV(UDRIE0);
+}
+
+ISR(USART_UDRE_vect) {
+    UDR0 = spi_tx_row_select[spi_tx_index];
+    if (++spi_tx_index == sizeof(spi_tx_row_select)) {
+        UCSR0B &= ~_BV(UDRIE0);
+    }
+}
+
+#else
+#error "unknown SPI_DRIVER"
+#endif
+
+uint8_t spi_master_clock_divider(void) {
+    return spi_clock_divider;
+}
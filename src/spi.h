@@ -1,18 +1,64 @@
-#ifndef SPI_H_
-#define SPI_H_
-
-#include <avr/io.h>
-
-#define SPI_LATCH_ON PORTB |= (1<<PB2)
-#define SPI_LATCH_OFF PORTB &= ~(1<<PB2)
-
-void spi_master_init(void);
-void spi_master_tx_16bits_blocking(uint16_t data_bytes);
-void spi_master_tx_32bits_blocking(uint32_t data_bytes);
-
-void inline spi_latch_trigger(void) {
-    SPI_LATCH_ON;
-    SPI_LATCH_OFF;
-}
-
-#endif /* SPI_H_ */
\ No newline at end of file
+#ifndef SPI_H_
+#define SPI_H_
+
+#include <avr/io.h>
+
+#include <stdbool.h>
+
+/*
+ * Output driver for the shift register chain. SPI_DRIVER_SPI uses the SPI
+ * peripheral (MOSI PB3, SCK PB5) and waits for every byte. SPI_DRIVER_USART
+ * uses USART0 in master SPI mode (TXD PD1, XCK PD4), whose double buffered
+ * transmitter is fed from the data register empty interrupt, so the CPU is
+ * free while the row shifts out.
+ */
+#define SPI_DRIVER_SPI 0
+#define SPI_DRIVER_USART 1
+
+#ifndef SPI_DRIVER
+#define SPI_DRIVER SPI_DRIVER_SPI
+#endif
+
+// shifts at fosc/8 instead of fosc/16 after spi_master_init()
+#ifndef SPI_CLOCK_2X
+#define SPI_CLOCK_2X 0
+#endif
+
+#ifndef SPI_CLOCK_DIVIDER
+#if SPI_CLOCK_2X
+#define SPI_CLOCK_DIVIDER 8
+#else
+#define SPI_CLOCK_DIVIDER 16
+#endif
+#endif
+
+// both drivers take power of two dividers in this range
+#define SPI_CLOCK_DIVIDER_MIN 2
+#define SPI_CLOCK_DIVIDER_MAX 128
+
+// columns followed by the one-hot row select
+#define SPI_ROW_BITS 48
+
+#define SPI_LATCH_ON PORTB |= (1<<PB2)
+#define SPI_LATCH_OFF PORTB &= ~(1<<PB2)
+
+void spi_master_init(void);
+// the shift clock is fosc / divider, invalid dividers are ignored
+bool spi_master_set_clock_divider(uint8_t divider);
+uint8_t spi_master_clock_divider(void);
+// starts shifting out a row, it is complete before the next latch as long as
+// rows are at least SPI_ROW_BITS * SPI_CLOCK_DIVIDER cycles apart
+void spi_master_tx_row(uint16_t columns, uint8_t row);
+
+static inline bool spi_master_clock_divider_valid(uint8_t divider) {
+    return divider >= SPI_CLOCK_DIVIDER_MIN
+           && divider <= SPI_CLOCK_DIVIDER_MAX
+           && !(divider & (divider - 1));
+}
+
+static inline void spi_latch_trigger(void) {
+    SPI_LATCH_ON;
+    SPI_LATCH_OFF;
+}
+
+#endif /* SPI_H_ */
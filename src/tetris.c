@@ -1,489 +1,691 @@
-#include <string.h>
-
-#include "gametoy.h"
-#include "tetris.h"
-#include "utils.h"
-#include "welcome_screen.h"
-
-typedef enum {
-    BLOCK_TYPE_I,
-    BLOCK_TYPE_J,
-    BLOCK_TYPE_L,
-    BLOCK_TYPE_O,
-    BLOCK_TYPE_S,
-    BLOCK_TYPE_T,
-    BLOCK_TYPE_Z,
-    _BLOCK_TYPE_COUNT
-} block_type_t;
-
-static const uint8_t BLOCKS_BITMAP[_BLOCK_TYPE_COUNT][2] = {
-        [BLOCK_TYPE_I] = {0b11110000, 0b00000000},
-        [BLOCK_TYPE_J] = {0b11100000, 0b00100000},
-        [BLOCK_TYPE_L] = {0b11100000, 0b10000000},
-        [BLOCK_TYPE_O] = {0b01100000, 0b01100000},
-        [BLOCK_TYPE_S] = {0b01100000, 0b11000000},
-        [BLOCK_TYPE_T] = {0b11100000, 0b01000000},
-        [BLOCK_TYPE_Z] = {0b11000000, 0b01100000}};
-
-static const uint16_t WALLS = 0xc003;
-
-static struct {
-    uint16_t current_block[24]; // 8-31
-    uint16_t old_blocks[24];    // 8-31
-    uint16_t next_block[2];     // 3-4
-    uint16_t points[5];         // 1-5
-    uint8_t animation[WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE];
-} framebuffers;
-
-static struct {
-    block_type_t block;
-    uint8_t x;
-    uint8_t y;
-} current_block;
-
-static uint16_t points_counter;
-static uint32_t periodic_elapsed_ms;
-static block_type_t next_block;
-
-static void update_points_framebuffer(void) {
-    if (points_counter >= 1000) {
-        points_counter = 0;
-    }
-    memset(framebuffers.points, 0, sizeof(framebuffers.points));
-    gametoy_update_points_framebuffer(framebuffers.points, points_counter);
-}
-
-static void delete_full_levels(void) {
-    uint8_t i = ARRAY_SIZE(framebuffers.old_blocks) - 1;
-    int8_t bonus = 0;
-    while (i != 0) {
-        if ((framebuffers.old_blocks[i] | WALLS) == 0xffff) {
-            for (uint8_t j = i; j > 0; j--) {
-                framebuffers.old_blocks[j] = framebuffers.old_blocks[j - 1];
-            }
-            framebuffers.old_blocks[0] = 0x0000;
-            points_counter++;
-            bonus++;
-            continue;
-        }
-        i--;
-    }
-
-    if (--bonus > 0) {
-        points_counter += bonus;
-    }
-
-    update_points_framebuffer();
-}
-
-static void game_over(void) {
-    gametoy_game_over(points_counter);
-}
-
-static void block_generate_new(void) {
-    current_block.block = next_block;
-    current_block.x = 7;
-    current_block.y = 0;
-
-    memset(framebuffers.current_block, 0, sizeof(framebuffers.current_block));
-
-    for (uint8_t i = 0; i < ARRAY_SIZE(BLOCKS_BITMAP[current_block.block]);
-         i++) {
-        framebuffers.current_block[i] =
-                (uint16_t)(BLOCKS_BITMAP[current_block.block][i]) << 2;
-    }
-
-    for (uint8_t i = 0; i < ARRAY_SIZE(BLOCKS_BITMAP[current_block.block]);
-         i++) {
-        if (framebuffers.current_block[i] & framebuffers.old_blocks[i]) {
-            game_over();
-        }
-    }
-}
-
-static block_type_t block_generate_random(void) {
-    uint16_t random_value = gametoy_get_random_value();
-    block_type_t ret = random_value % _BLOCK_TYPE_COUNT;
-
-    return ret;
-}
-
-static void block_generate_next(void) {
-    next_block = block_generate_random();
-    memset(framebuffers.next_block, 0, sizeof(framebuffers.next_block));
-    for (uint8_t i = 0; i < ARRAY_SIZE(framebuffers.next_block); i++) {
-        framebuffers.next_block[i] =
-                (uint16_t)(BLOCKS_BITMAP[next_block][i]) >> 4;
-    }
-}
-
-static bool is_space_down(void) {
-    if (framebuffers.current_block[ARRAY_SIZE(framebuffers.current_block) - 1]
-        != 0) {
-        return false;
-    }
-
-    for (uint8_t i = 1; i < ARRAY_SIZE(framebuffers.old_blocks); i++) {
-        if (framebuffers.old_blocks[i] & framebuffers.current_block[i - 1]) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-static bool is_space_right(void) {
-    for (uint8_t i = 0; i < ARRAY_SIZE(framebuffers.current_block); i++) {
-        if (framebuffers.current_block[i] >> 1 & framebuffers.old_blocks[i]) {
-            return false;
-        }
-        if (framebuffers.current_block[i] >> 1 & WALLS) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-static bool is_space_left(void) {
-    for (uint8_t i = 0; i < ARRAY_SIZE(framebuffers.current_block); i++) {
-        if (framebuffers.current_block[i] << 1 & framebuffers.old_blocks[i]) {
-            return false;
-        }
-        if (framebuffers.current_block[i] << 1 & WALLS) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-static bool block_move_down(void) {
-    if (is_space_down()) {
-        for (uint8_t i = ARRAY_SIZE(framebuffers.current_block) - 1; i > 0;
-             i--) {
-            framebuffers.current_block[i] = framebuffers.current_block[i - 1];
-        }
-        framebuffers.current_block[0] = 0x0000;
-        current_block.y++;
-
-        return true;
-    } else {
-        for (uint8_t i = 0; i < ARRAY_SIZE(framebuffers.old_blocks); i++) {
-            framebuffers.old_blocks[i] |= framebuffers.current_block[i];
-        }
-    }
-
-    delete_full_levels();
-
-    block_generate_new();
-    block_generate_next();
-
-    return false;
-}
-
-static void blocks_JSTZL_swap_bits(int8_t x_offset,
-                                   int8_t y_offset,
-                                   uint16_t *framebuffer_copy) {
-    int8_t x_copy_offset = y_offset;
-    int8_t y_copy_offset = -x_offset;
-
-    uint8_t bit;
-    if (current_block.y == 0 && y_copy_offset == -1) {
-        bit = 0;
-    } else {
-        uint16_t *source =
-                &framebuffers.current_block[current_block.y + y_copy_offset];
-        uint8_t source_offset = 15 - current_block.x - x_copy_offset;
-        bit = utils_bit_is_set(source, source_offset);
-    }
-
-    uint16_t *destination = &framebuffer_copy[y_offset + 1];
-    uint8_t destination_offset = 15 - current_block.x - x_offset;
-    utils_bit_set_to(destination, destination_offset, bit);
-}
-
-static void blocks_JSTZL_rotate(void) {
-    if (current_block.y == 0) {
-        return;
-    }
-
-#define COPY_SIZE 3
-    uint16_t framebuffer_copy[COPY_SIZE] = {};
-    for (int8_t i = -1; i < COPY_SIZE - 1; i++) {
-        for (int8_t j = -1; j < COPY_SIZE - 1; j++) {
-            blocks_JSTZL_swap_bits(i, j, framebuffer_copy);
-        }
-    }
-
-    if (current_block.y == ARRAY_SIZE(framebuffers.current_block) - 1
-        && framebuffer_copy[COPY_SIZE] != 0) {
-        return;
-    }
-    for (uint8_t i = 0; i < COPY_SIZE; i++) {
-        if (framebuffer_copy[i] & WALLS) {
-            return;
-        }
-        if (framebuffer_copy[i]
-            & framebuffers.old_blocks[current_block.y - 1 + i]) {
-            return;
-        }
-    }
-
-    memcpy(&framebuffers.current_block[current_block.y - 1], framebuffer_copy,
-           COPY_SIZE * sizeof(uint16_t));
-
-#undef COPY_SIZE
-}
-
-static void blocks_I_swap_bits(int8_t start_x,
-                               int8_t start_y,
-                               uint16_t *framebuffer_copy,
-                               size_t size) {
-    for (uint8_t x = 0; x < size; x++) {
-        for (uint8_t y = 0; y < size; y++) {
-            uint8_t bit =
-                    utils_bit_is_set(&framebuffers.current_block[start_y + y],
-                                     15 - start_x - x);
-            utils_bit_set_to(&framebuffer_copy[x], 15 - (start_x + 3 - y), bit);
-        }
-    }
-}
-
-static void blocks_I_rotate(void) {
-    enum { STATE_U, STATE_D, STATE_L, STATE_R } i_block_state;
-    uint16_t framebuffer_copy[4] = {};
-
-    struct {
-        uint8_t x;
-        uint8_t y;
-    } start;
-
-    if (current_block.y == 0) {
-        return;
-    }
-
-    if (framebuffers.current_block[current_block.y - 1] == 0x0000) {
-        if (utils_bit_is_set(&framebuffers.current_block[current_block.y],
-                             15 - (current_block.x - 2))) {
-            i_block_state = STATE_D;
-            start.x = current_block.x - 2;
-            start.y = current_block.y - 2;
-        } else {
-            i_block_state = STATE_U;
-            start.x = current_block.x - 1;
-            start.y = current_block.y - 1;
-        }
-    } else {
-        if (current_block.y + 2 > ARRAY_SIZE(framebuffers.current_block) - 1) {
-            return;
-        }
-        if (utils_bit_is_set(&framebuffers.current_block[current_block.y + 2],
-                             15 - (current_block.x))) {
-            i_block_state = STATE_R;
-            start.x = current_block.x - 2;
-            start.y = current_block.y - 1;
-        } else {
-            i_block_state = STATE_L;
-            start.x = current_block.x - 1;
-            start.y = current_block.y - 2;
-        }
-    }
-
-    if (current_block.y == ARRAY_SIZE(framebuffers.current_block) - 2
-        && i_block_state == STATE_U) {
-        return;
-    }
-    if (current_block.y == ARRAY_SIZE(framebuffers.current_block) - 1
-        && i_block_state == STATE_D) {
-        return;
-    }
-
-    blocks_I_swap_bits(start.x, start.y, framebuffer_copy,
-                       ARRAY_SIZE(framebuffer_copy));
-
-    for (uint8_t i = 0; i < ARRAY_SIZE(framebuffer_copy); i++) {
-        if (framebuffer_copy[i] & framebuffers.old_blocks[start.y + i]) {
-            return;
-        }
-        if (framebuffer_copy[i] & WALLS) {
-            return;
-        }
-    }
-
-    memcpy(&framebuffers.current_block[start.y], framebuffer_copy,
-           sizeof(framebuffer_copy));
-    switch (i_block_state) {
-    case STATE_D:
-        current_block.x--;
-        break;
-    case STATE_U:
-        current_block.x++;
-        break;
-    case STATE_R:
-        current_block.y++;
-        break;
-    case STATE_L:
-        current_block.y--;
-        break;
-    default:
-        break;
-    }
-}
-
-static void tetris_right_button_action() {
-    if (!is_space_right()) {
-        return;
-    }
-
-    for (uint8_t i = 0; i < ARRAY_SIZE(framebuffers.current_block); i++) {
-        framebuffers.current_block[i] = framebuffers.current_block[i] >> 1;
-    }
-
-    current_block.x++;
-}
-
-static void tetris_left_button_action() {
-    if (!is_space_left()) {
-        return;
-    }
-
-    for (uint8_t i = 0; i < ARRAY_SIZE(framebuffers.current_block); i++) {
-        framebuffers.current_block[i] = framebuffers.current_block[i] << 1;
-    }
-    current_block.x--;
-}
-
-static void tetris_up_button_action() {
-    switch (current_block.block) {
-    case BLOCK_TYPE_O:
-        break;
-    case BLOCK_TYPE_J:
-    case BLOCK_TYPE_S:
-    case BLOCK_TYPE_T:
-    case BLOCK_TYPE_Z:
-    case BLOCK_TYPE_L:
-        blocks_JSTZL_rotate();
-        break;
-    case BLOCK_TYPE_I:
-        blocks_I_rotate();
-        break;
-    default:
-        break;
-    }
-}
-
-static void tetris_down_button_action() {
-    block_move_down();
-    periodic_elapsed_ms = 0;
-}
-
-static bool tetris_periodic_action(uint32_t delay_ms) {
-    periodic_elapsed_ms += delay_ms;
-    uint16_t timer_indicator = points_counter < 30 ? points_counter : 30;
-    if (periodic_elapsed_ms < 500 - 15 * timer_indicator) {
-        return false;
-    }
-
-    periodic_elapsed_ms = 0;
-    return block_move_down();
-}
-
-static void tetris_update_gametoy_framebuffer(uint16_t *gametoy_framebuffer) {
-    memset(gametoy_framebuffer, 0, GAMETOY_DISPLAY_SIZE * sizeof(uint16_t));
-    for (uint8_t i = 0; i < GAMETOY_DISPLAY_SIZE; i++) {
-        if (i >= 1 && i < 1 + ARRAY_SIZE(framebuffers.points)) {
-            gametoy_framebuffer[i] |= framebuffers.points[i - 1];
-        }
-        if (i >= 3 && i < 3 + ARRAY_SIZE(framebuffers.next_block)) {
-            gametoy_framebuffer[i] |= framebuffers.next_block[i - 3];
-        }
-        if (i == 7) {
-            gametoy_framebuffer[i] = 0xffff;
-        }
-        if (i >= 8 && i < 8 + ARRAY_SIZE(framebuffers.old_blocks)) {
-            gametoy_framebuffer[i] |= WALLS;
-            gametoy_framebuffer[i] |= framebuffers.old_blocks[i - 8];
-            gametoy_framebuffer[i] |= framebuffers.current_block[i - 8];
-        }
-    }
-}
-
-static void tetris_initialize(void) {
-    update_points_framebuffer();
-    block_generate_new();
-    block_generate_next();
-}
-
-static uint8_t *tetris_game_animation(void) {
-    // i was too lazy to create an animation algorithm
-    static uint8_t counter;
-
-    if (counter == 0) {
-        framebuffers.animation[0] = 0b00000000;
-        framebuffers.animation[1] = 0b00000000;
-        framebuffers.animation[2] = 0b01110000;
-        framebuffers.animation[3] = 0b00100000;
-        framebuffers.animation[4] = 0b00000101;
-        framebuffers.animation[5] = 0b10000111;
-        framebuffers.animation[6] = 0b10001111;
-        framebuffers.animation[7] = 0b11011111;
-    } else if (counter == 1) {
-        framebuffers.animation[0] = 0b00000000;
-        framebuffers.animation[1] = 0b00000000;
-        framebuffers.animation[2] = 0b00000000;
-        framebuffers.animation[3] = 0b01110000;
-        framebuffers.animation[4] = 0b00100101;
-        framebuffers.animation[5] = 0b10000111;
-        framebuffers.animation[6] = 0b10001111;
-        framebuffers.animation[7] = 0b11011111;
-    } else if (counter == 2) {
-        framebuffers.animation[0] = 0b00000000;
-        framebuffers.animation[1] = 0b00000000;
-        framebuffers.animation[2] = 0b00000000;
-        framebuffers.animation[3] = 0b00000000;
-        framebuffers.animation[4] = 0b01110101;
-        framebuffers.animation[5] = 0b10100111;
-        framebuffers.animation[6] = 0b10001111;
-        framebuffers.animation[7] = 0b11011111;
-    } else if (counter == 3) {
-        framebuffers.animation[0] = 0b00000000;
-        framebuffers.animation[1] = 0b00000000;
-        framebuffers.animation[2] = 0b00000000;
-        framebuffers.animation[3] = 0b00000000;
-        framebuffers.animation[4] = 0b00000101;
-        framebuffers.animation[5] = 0b11110111;
-        framebuffers.animation[6] = 0b10101111;
-        framebuffers.animation[7] = 0b11011111;
-    } else if (counter == 4) {
-        framebuffers.animation[0] = 0b00000000;
-        framebuffers.animation[1] = 0b00000000;
-        framebuffers.animation[2] = 0b00000000;
-        framebuffers.animation[3] = 0b00000000;
-        framebuffers.animation[4] = 0b00000101;
-        framebuffers.animation[5] = 0b10000111;
-        framebuffers.animation[6] = 0b11111111;
-        framebuffers.animation[7] = 0b11111111;
-    }
-
-    counter++;
-    if (counter == 5) {
-        counter = 0;
-    }
-
-    return framebuffers.animation;
-}
-
-static gametoy_actions_t tetris_actions = {
-        .right_button_action = &tetris_right_button_action,
-        .left_button_action = &tetris_left_button_action,
-        .up_button_action = &tetris_up_button_action,
-        .down_button_action = &tetris_down_button_action,
-        .periodic_action = &tetris_periodic_action,
-        .update_gametoy_framebuffer = &tetris_update_gametoy_framebuffer,
-        .initialize = &tetris_initialize};
-
-void tetris_game_install() {
-    gametoy_game_install(&tetris_actions, GAME_TYPE_TETRIS);
-    welcome_screen_animation_install(tetris_game_animation, GAME_TYPE_TETRIS);
-}
+#include <avr/pgmspace.h>
+
+#include <string.h>
+
+#include "gametoy.h"
+#include "tetris.h"
+#include "utils.h"
+#include "welcome_screen.h"
+
+typedef enum {
+    BLOCK_TYPE_I,
+    BLOCK_TYPE_J,
+    BLOCK_TYPE_L,
+    BLOCK_TYPE_O,
+    BLOCK_TYPE_S,
+    BLOCK_TYPE_T,
+    BLOCK_TYPE_Z,
+    _BLOCK_TYPE_COUNT
+} block_type_t;
+
+#define BLOCK_SIZE 4
+#define BLOCK_ROTATIONS 4
+
+// every rotation of a block inside its 4x4 box, one nibble per box row;
+// the rotations are clockwise, around the box center for I and O and around
+// the center of the upper left 3x3 square for the others
+static const uint8_t BLOCKS_BITMAP[_BLOCK_TYPE_COUNT][BLOCK_ROTATIONS]
+                                  [BLOCK_SIZE] PROGMEM = {
+        [BLOCK_TYPE_I] = {{0b0000, 0b1111, 0b0000, 0b0000},
+                          {0b0010, 0b0010, 0b0010, 0b0010},
+                          {0b0000, 0b0000, 0b1111, 0b0000},
+                          {0b0100, 0b0100, 0b0100, 0b0100}},
+        [BLOCK_TYPE_J] = {{0b0000, 0b1110, 0b0010, 0b0000},
+                          {0b0100, 0b0100, 0b1100, 0b0000},
+                          {0b1000, 0b1110, 0b0000, 0b0000},
+                          {0b0110, 0b0100, 0b0100, 0b0000}},
+        [BLOCK_TYPE_L] = {{0b0000, 0b1110, 0b1000, 0b0000},
+                          {0b1100, 0b0100, 0b0100, 0b0000},
+                          {0b0010, 0b1110, 0b0000, 0b0000},
+                          {0b0100, 0b0100, 0b0110, 0b0000}},
+        [BLOCK_TYPE_O] = {{0b0000, 0b0110, 0b0110, 0b0000},
+                          {0b0000, 0b0110, 0b0110, 0b0000},
+                          {0b0000, 0b0110, 0b0110, 0b0000},
+                          {0b0000, 0b0110, 0b0110, 0b0000}},
+        [BLOCK_TYPE_S] = {{0b0000, 0b0110, 0b1100, 0b0000},
+                          {0b1000, 0b1100, 0b0100, 0b0000},
+                          {0b0110, 0b1100, 0b0000, 0b0000},
+                          {0b0100, 0b0110, 0b0010, 0b0000}},
+        [BLOCK_TYPE_T] = {{0b0000, 0b1110, 0b0100, 0b0000},
+                          {0b0100, 0b1100, 0b0100, 0b0000},
+                          {0b0100, 0b1110, 0b0000, 0b0000},
+                          {0b0100, 0b0110, 0b0100, 0b0000}},
+        [BLOCK_TYPE_Z] = {{0b0000, 0b1100, 0b0110, 0b0000},
+                          {0b0100, 0b1100, 0b1000, 0b0000},
+                          {0b1100, 0b0110, 0b0000, 0b0000},
+                          {0b0010, 0b0110, 0b0100, 0b0000}}};
+
+// horizontal offsets tried in turn when a rotated block does not fit
+static const int8_t WALL_KICKS[] = {0, 1, -1, 2, -2};
+
+#define BLOCK_MAX_X (16 - BLOCK_SIZE)
+#define BLOCK_SPAWN_X 6
+#define BLOCK_SPAWN_Y -1
+
+// a second down press within this time drops the block all the way; it is
+// kept well below the pace of deliberate soft drop taps
+#ifndef TETRIS_HARD_DROP_DOUBLE_TAP_MS
+#define TETRIS_HARD_DROP_DOUBLE_TAP_MS 120
+#endif
+
+// time between the demo's button presses, keep it below the double tap time
+#ifndef TETRIS_AUTOPLAY_PRESS_MS
+#define TETRIS_AUTOPLAY_PRESS_MS 45
+#endif
+#if TETRIS_AUTOPLAY_PRESS_MS >= TETRIS_HARD_DROP_DOUBLE_TAP_MS
+#error "TETRIS_AUTOPLAY_PRESS_MS must be below TETRIS_HARD_DROP_DOUBLE_TAP_MS"
+#endif
+
+// placement score weights per cleared line, height and hole unit
+#define AUTOPLAY_LINES_WEIGHT 76
+#define AUTOPLAY_HEIGHT_WEIGHT -51
+#define AUTOPLAY_HOLES_WEIGHT -36
+#define AUTOPLAY_BUMPINESS_WEIGHT -18
+// left column of every pair of neighbouring playfield columns
+#define AUTOPLAY_COLUMN_PAIRS 0x1ffc
+
+static const uint16_t WALLS = 0xc003;
+
+#define POINTS_ROW 1
+#define NEXT_BLOCK_ROW 3
+#define SEPARATOR_ROW 7
+#define PLAYFIELD_ROW 8
+
+static struct {
+    uint16_t old_blocks[24];    // 8-31
+    uint16_t next_block[2];     // 3-4
+    uint16_t points[5];         // 1-5
+    uint16_t animation[WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE];
+} framebuffers;
+
+// x is the playfield column of the box's left edge (bit 15 - x), y the
+// playfield row of its top row and rows the box rows shifted to x
+static struct {
+    block_type_t block;
+    uint8_t rotation;
+    int8_t x;
+    int8_t y;
+    uint16_t rows[BLOCK_SIZE];
+    int8_t landing_y;
+    uint16_t ghost_rows[BLOCK_SIZE];
+} current_block;
+
+// the walls, the score and the ghost stay dim so the blocks stand out
+enum {
+    LAYER_POINTS,
+    LAYER_NEXT_BLOCK,
+    LAYER_SEPARATOR,
+    LAYER_WALLS,
+    LAYER_OLD_BLOCKS,
+    LAYER_GHOST,
+    LAYER_CURRENT_BLOCK,
+    _LAYER_COUNT
+};
+
+static display_layer_t layers[_LAYER_COUNT];
+
+// row of the topmost well cell in every column (by bit), the well height
+// for empty columns
+static uint8_t well_column_top[16];
+
+static uint16_t points_counter;
+static gametoy_timer_t gravity_timer;
+static gametoy_timer_t hard_drop_timer;
+static bool hard_drop_armed;
+// set once the game is over, nothing may change the finished game
+static bool game_lost;
+
+// placement the demo steers the current block to
+static struct {
+    bool planned;
+    uint8_t rotation;
+    int8_t x;
+    uint16_t elapsed_ms;
+} autoplay;
+static block_type_t next_block;
+
+static void update_points_framebuffer(void) {
+    if (points_counter >= 1000) {
+        points_counter = 0;
+    }
+    memset(framebuffers.points, 0, sizeof(framebuffers.points));
+    gametoy_update_points_framebuffer(framebuffers.points, points_counter);
+}
+
+static void well_column_top_update(uint16_t cells, uint8_t row) {
+    for (; cells; cells &= cells - 1) {
+        uint8_t column = utils_lowest_bit(cells);
+        if (row < well_column_top[column]) {
+            well_column_top[column] = row;
+        }
+    }
+}
+
+static void well_column_top_rebuild(void) {
+    memset(well_column_top, ARRAY_SIZE(framebuffers.old_blocks),
+           sizeof(well_column_top));
+    for (uint8_t i = 0; i < ARRAY_SIZE(framebuffers.old_blocks); i++) {
+        well_column_top_update(framebuffers.old_blocks[i], i);
+    }
+}
+
+// columns topped above the cleared lines just sink, the others are looked
+// up again from the top of the compacted well
+static void well_column_top_clear(uint8_t highest_cleared, uint8_t cleared) {
+    uint16_t lookup = 0;
+    for (uint8_t column = 0; column < ARRAY_SIZE(well_column_top); column++) {
+        if (well_column_top[column] < highest_cleared) {
+            well_column_top[column] += cleared;
+        } else {
+            well_column_top[column] = ARRAY_SIZE(framebuffers.old_blocks);
+            lookup |= (uint16_t) 1 << column;
+        }
+    }
+
+    lookup &= (uint16_t) ~WALLS;
+    for (uint8_t i = highest_cleared + cleared;
+         lookup && i < ARRAY_SIZE(framebuffers.old_blocks); i++) {
+        uint16_t cells = framebuffers.old_blocks[i] & lookup;
+        lookup &= ~cells;
+        well_column_top_update(cells, i);
+    }
+}
+
+// compacts the well in one pass from the bottom, every kept row is copied
+// once to its final position
+static void delete_full_levels(void) {
+    uint8_t write = ARRAY_SIZE(framebuffers.old_blocks);
+    uint8_t highest_cleared = 0;
+    uint8_t cleared = 0;
+    for (uint8_t read = ARRAY_SIZE(framebuffers.old_blocks); read-- > 0;) {
+        uint16_t row = framebuffers.old_blocks[read];
+        if ((row | WALLS) == 0xffff) {
+            highest_cleared = read;
+            cleared++;
+            continue;
+        }
+        write--;
+        if (write != read) {
+            framebuffers.old_blocks[write] = row;
+        }
+    }
+
+    if (!cleared) {
+        return;
+    }
+
+    memset(framebuffers.old_blocks, 0, write * sizeof(uint16_t));
+    well_column_top_clear(highest_cleared, cleared);
+
+    // every line after the first one scores a bonus point
+    points_counter += 2 * cleared - 1;
+    update_points_framebuffer();
+}
+
+static void game_over(void) {
+    game_lost = true;
+    gametoy_game_over(points_counter);
+}
+
+static uint16_t block_row(uint8_t rotation, uint8_t row, int8_t x) {
+    uint8_t bits = pgm_read_byte(
+            &BLOCKS_BITMAP[current_block.block][rotation][row]);
+
+    return ((uint16_t) bits << 12) >> x;
+}
+
+static bool block_fits(uint8_t rotation, int8_t x, int8_t y) {
+    // further right the box would shift cells out of the row
+    if (x < 0 || x > BLOCK_MAX_X) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < BLOCK_SIZE; i++) {
+        uint16_t row = block_row(rotation, i, x);
+        if (!row) {
+            continue;
+        }
+        int8_t field_row = y + i;
+        if (field_row < 0
+            || field_row >= (int8_t) ARRAY_SIZE(framebuffers.old_blocks)) {
+            return false;
+        }
+        if (row & (framebuffers.old_blocks[field_row] | WALLS)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the ghost shows the bottom outline of the block where it would land
+static uint16_t block_ghost_row(uint8_t row) {
+    uint16_t below = 0;
+    for (uint8_t i = row + 1; i < BLOCK_SIZE; i++) {
+        below |= current_block.rows[i];
+    }
+
+    return current_block.rows[row] & ~below;
+}
+
+// rows of a block spawned above the well are empty, so the layer may start
+// on the separator row
+static void block_update_layers(void) {
+    layers[LAYER_CURRENT_BLOCK].first_row = PLAYFIELD_ROW + current_block.y;
+    layers[LAYER_GHOST].first_row = PLAYFIELD_ROW + current_block.landing_y;
+}
+
+// the highest well cell under every block column bounds the fall, unless
+// the block was slid under an overhang and has to be stepped down instead
+static int8_t block_landing_y(const uint16_t *rows, uint8_t rotation, int8_t x,
+                              int8_t y) {
+    int8_t landing_y = ARRAY_SIZE(framebuffers.old_blocks);
+    uint16_t seen = 0;
+    for (int8_t i = BLOCK_SIZE - 1; i >= 0; i--) {
+        uint16_t cells = rows[i] & ~seen;
+        seen |= rows[i];
+        for (; cells; cells &= cells - 1) {
+            uint8_t column = utils_lowest_bit(cells);
+            int8_t column_y = well_column_top[column] - 1 - i;
+            if (column_y < landing_y) {
+                landing_y = column_y;
+            }
+        }
+    }
+
+    if (landing_y < y) {
+        landing_y = y;
+        while (block_fits(rotation, x, landing_y + 1)) {
+            landing_y++;
+        }
+    }
+
+    return landing_y;
+}
+
+static void block_load_rows(void) {
+    for (uint8_t i = 0; i < BLOCK_SIZE; i++) {
+        current_block.rows[i] =
+                block_row(current_block.rotation, i, current_block.x);
+    }
+    current_block.landing_y =
+            block_landing_y(current_block.rows, current_block.rotation,
+                            current_block.x, current_block.y);
+    for (uint8_t i = 0; i < BLOCK_SIZE; i++) {
+        current_block.ghost_rows[i] = block_ghost_row(i);
+    }
+    block_update_layers();
+}
+
+static bool block_move(uint8_t rotation, int8_t x, int8_t y) {
+    if (!block_fits(rotation, x, y)) {
+        return false;
+    }
+
+    current_block.rotation = rotation;
+    current_block.x = x;
+    current_block.y = y;
+    block_load_rows();
+
+    return true;
+}
+
+static void block_generate_new(void) {
+    current_block.block = next_block;
+    current_block.rotation = 0;
+    current_block.x = BLOCK_SPAWN_X;
+    current_block.y = BLOCK_SPAWN_Y;
+    block_load_rows();
+    autoplay.planned = false;
+    // a double tap on the last block must not drop this one
+    hard_drop_armed = false;
+    gametoy_timer_stop(&hard_drop_timer);
+
+    if (!block_fits(current_block.rotation, current_block.x,
+                    current_block.y)) {
+        game_over();
+    }
+}
+
+static block_type_t block_generate_random(void) {
+    uint16_t random_value = gametoy_get_random_value();
+    block_type_t ret = random_value % _BLOCK_TYPE_COUNT;
+
+    return ret;
+}
+
+static void block_generate_next(void) {
+    next_block = block_generate_random();
+    memset(framebuffers.next_block, 0, sizeof(framebuffers.next_block));
+    for (uint8_t i = 0; i < ARRAY_SIZE(framebuffers.next_block); i++) {
+        framebuffers.next_block[i] =
+                pgm_read_byte(&BLOCKS_BITMAP[next_block][0][i + 1]);
+    }
+}
+
+static bool block_move_down(void) {
+    if (block_move(current_block.rotation, current_block.x,
+                   current_block.y + 1)) {
+        return true;
+    }
+
+    for (uint8_t i = 0; i < BLOCK_SIZE; i++) {
+        if (current_block.rows[i]) {
+            framebuffers.old_blocks[current_block.y + i] |=
+                    current_block.rows[i];
+            well_column_top_update(current_block.rows[i],
+                                   current_block.y + i);
+        }
+    }
+
+    delete_full_levels();
+
+    block_generate_new();
+    if (game_lost) {
+        return false;
+    }
+    block_generate_next();
+
+    return false;
+}
+
+static void block_rotate(void) {
+    uint8_t rotation = (current_block.rotation + 1) % BLOCK_ROTATIONS;
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(WALL_KICKS); i++) {
+        if (block_move(rotation, current_block.x + WALL_KICKS[i],
+                       current_block.y)) {
+            return;
+        }
+    }
+}
+
+static void tetris_right_button_action() {
+    block_move(current_block.rotation, current_block.x + 1, current_block.y);
+}
+
+static void tetris_left_button_action() {
+    block_move(current_block.rotation, current_block.x - 1, current_block.y);
+}
+
+static void tetris_up_button_action() {
+    if (current_block.block == BLOCK_TYPE_O) {
+        return;
+    }
+
+    block_rotate();
+}
+
+static void block_hard_drop(void) {
+    block_move(current_block.rotation, current_block.x,
+               current_block.landing_y);
+    block_move_down();
+}
+
+static uint32_t gravity_period_ms(void) {
+    uint16_t timer_indicator = points_counter < 30 ? points_counter : 30;
+
+    return 500 - 15 * timer_indicator;
+}
+
+static void gravity_timer_callback(void) {
+    block_move_down();
+    if (game_lost) {
+        return;
+    }
+    gravity_timer.period_ms = gravity_period_ms();
+}
+
+static void gravity_timer_restart(void) {
+    gametoy_timer_start(&gravity_timer, gravity_period_ms(),
+                        gravity_period_ms(), gravity_timer_callback);
+}
+
+static void hard_drop_timer_callback(void) {
+    hard_drop_armed = false;
+}
+
+static void tetris_down_button_action() {
+    if (hard_drop_armed) {
+        hard_drop_armed = false;
+        block_hard_drop();
+    } else if (block_move_down()) {
+        // only a block that is still falling can be dropped by a second tap
+        hard_drop_armed = true;
+        gametoy_timer_start(&hard_drop_timer,
+                            TETRIS_HARD_DROP_DOUBLE_TAP_MS, 0,
+                            hard_drop_timer_callback);
+    }
+    if (game_lost) {
+        return;
+    }
+    gravity_timer_restart();
+}
+
+// scores the well with the block locked at y, in one pass over the rows
+// with every column kept as a bit: a column is covered from its top cell
+// down, so summing the covered columns per row gives the aggregate height
+// and summing neighbours that differ in coverage gives the bumpiness
+static int32_t autoplay_evaluate(const uint16_t *rows, int8_t y,
+                                 uint8_t first_row) {
+    uint16_t covered = 0;
+    uint8_t covered_count = 0;
+    uint8_t lines = 0;
+    uint16_t height = 0;
+    uint16_t holes = 0;
+    uint16_t bumpiness = 0;
+    for (uint8_t i = first_row; i < ARRAY_SIZE(framebuffers.old_blocks);
+         i++) {
+        uint16_t row = framebuffers.old_blocks[i];
+        uint8_t box_row = i - y;
+        if (box_row < BLOCK_SIZE) {
+            row |= rows[box_row];
+        }
+        if ((row | WALLS) == 0xffff) {
+            lines++;
+            continue;
+        }
+
+        covered_count += utils_popcount(row & ~covered);
+        covered |= row;
+        height += covered_count;
+        holes += utils_popcount(covered & ~row);
+        bumpiness += utils_popcount((covered ^ (covered >> 1))
+                                    & AUTOPLAY_COLUMN_PAIRS);
+    }
+
+    return (int32_t) AUTOPLAY_LINES_WEIGHT * lines
+           + (int32_t) AUTOPLAY_HEIGHT_WEIGHT * height
+           + (int32_t) AUTOPLAY_HOLES_WEIGHT * holes
+           + (int32_t) AUTOPLAY_BUMPINESS_WEIGHT * bumpiness;
+}
+
+// tries every rotation and column of the current block from where it is
+static void autoplay_plan(void) {
+    uint8_t well_top = ARRAY_SIZE(framebuffers.old_blocks);
+    for (uint8_t column = 0; column < ARRAY_SIZE(well_column_top); column++) {
+        if (well_column_top[column] < well_top) {
+            well_top = well_column_top[column];
+        }
+    }
+
+    int8_t y = current_block.y < 0 ? 0 : current_block.y;
+    uint8_t rotations =
+            current_block.block == BLOCK_TYPE_O ? 1 : BLOCK_ROTATIONS;
+    int32_t best_score = INT32_MIN;
+    autoplay.rotation = current_block.rotation;
+    autoplay.x = current_block.x;
+    for (uint8_t rotation = 0; rotation < rotations; rotation++) {
+        for (int8_t x = 0; x <= BLOCK_MAX_X; x++) {
+            if (!block_fits(rotation, x, y)) {
+                continue;
+            }
+
+            uint16_t rows[BLOCK_SIZE];
+            for (uint8_t i = 0; i < BLOCK_SIZE; i++) {
+                rows[i] = block_row(rotation, i, x);
+            }
+            int8_t landing_y = block_landing_y(rows, rotation, x, y);
+            int32_t score = autoplay_evaluate(
+                    rows, landing_y,
+                    landing_y < (int8_t) well_top ? landing_y : well_top);
+            if (score > best_score) {
+                best_score = score;
+                autoplay.rotation = rotation;
+                autoplay.x = x;
+            }
+        }
+    }
+}
+
+static gametoy_button_t tetris_autoplay_action(uint32_t elapsed_ms) {
+    autoplay.elapsed_ms += elapsed_ms;
+    if (autoplay.elapsed_ms < TETRIS_AUTOPLAY_PRESS_MS) {
+        return GAMETOY_BUTTON_NONE;
+    }
+    autoplay.elapsed_ms = 0;
+
+    if (!autoplay.planned) {
+        autoplay_plan();
+        autoplay.planned = true;
+    }
+
+    if (current_block.rotation != autoplay.rotation) {
+        // a freshly spawned block may stick out of the well to rotate
+        return current_block.y < 0 ? GAMETOY_BUTTON_DOWN : GAMETOY_BUTTON_UP;
+    }
+    if (current_block.x < autoplay.x) {
+        return GAMETOY_BUTTON_RIGHT;
+    }
+    if (current_block.x > autoplay.x) {
+        return GAMETOY_BUTTON_LEFT;
+    }
+
+    // pressed twice in a row, this is a hard drop
+    return GAMETOY_BUTTON_DOWN;
+}
+
+static void layers_initialize(void) {
+    layers[LAYER_POINTS] = (display_layer_t){
+            .rows = framebuffers.points,
+            .first_row = POINTS_ROW,
+            .row_count = ARRAY_SIZE(framebuffers.points),
+            .planes = DISPLAY_LAYER_DIMMED};
+    layers[LAYER_NEXT_BLOCK] = (display_layer_t){
+            .rows = framebuffers.next_block,
+            .first_row = NEXT_BLOCK_ROW,
+            .row_count = ARRAY_SIZE(framebuffers.next_block),
+            .planes = DISPLAY_LAYER_FULL};
+    layers[LAYER_SEPARATOR] = (display_layer_t){
+            .first_row = SEPARATOR_ROW,
+            .row_count = 1,
+            .mask = 0xffff,
+            .planes = DISPLAY_LAYER_DIMMED};
+    layers[LAYER_WALLS] = (display_layer_t){
+            .first_row = PLAYFIELD_ROW,
+            .row_count = ARRAY_SIZE(framebuffers.old_blocks),
+            .mask = WALLS,
+            .planes = DISPLAY_LAYER_DIMMED};
+    layers[LAYER_OLD_BLOCKS] = (display_layer_t){
+            .rows = framebuffers.old_blocks,
+            .first_row = PLAYFIELD_ROW,
+            .row_count = ARRAY_SIZE(framebuffers.old_blocks),
+            .planes = DISPLAY_LAYER_FULL};
+    layers[LAYER_GHOST] = (display_layer_t){
+            .rows = current_block.ghost_rows,
+            .row_count = BLOCK_SIZE,
+            .planes = DISPLAY_LAYER_DIMMED};
+    layers[LAYER_CURRENT_BLOCK] = (display_layer_t){
+            .rows = current_block.rows,
+            .row_count = BLOCK_SIZE,
+            .planes = DISPLAY_LAYER_FULL};
+}
+
+static void tetris_initialize(void) {
+    // the demo starts over in the same well
+    memset(framebuffers.old_blocks, 0, sizeof(framebuffers.old_blocks));
+    points_counter = 0;
+    game_lost = false;
+    autoplay.elapsed_ms = 0;
+    // the game over wipe clips the layers
+    layers_initialize();
+    well_column_top_rebuild();
+    update_points_framebuffer();
+    block_generate_new();
+    block_generate_next();
+    gravity_timer_restart();
+}
+
+static uint16_t *tetris_game_animation(void) {
+    // i was too lazy to create an animation algorithm
+    static uint8_t counter;
+
+    if (counter == 0) {
+        framebuffers.animation[0] = 0b00000000;
+        framebuffers.animation[1] = 0b00000000;
+        framebuffers.animation[2] = 0b01110000;
+        framebuffers.animation[3] = 0b00100000;
+        framebuffers.animation[4] = 0b00000101;
+        framebuffers.animation[5] = 0b10000111;
+        framebuffers.animation[6] = 0b10001111;
+        framebuffers.animation[7] = 0b11011111;
+    } else if (counter == 1) {
+        framebuffers.animation[0] = 0b00000000;
+        framebuffers.animation[1] = 0b00000000;
+        framebuffers.animation[2] = 0b00000000;
+        framebuffers.animation[3] = 0b01110000;
+        framebuffers.animation[4] = 0b00100101;
+        framebuffers.animation[5] = 0b10000111;
+        framebuffers.animation[6] = 0b10001111;
+        framebuffers.animation[7] = 0b11011111;
+    } else if (counter == 2) {
+        framebuffers.animation[0] = 0b00000000;
+        framebuffers.animation[1] = 0b00000000;
+        framebuffers.animation[2] = 0b00000000;
+        framebuffers.animation[3] = 0b00000000;
+        framebuffers.animation[4] = 0b01110101;
+        framebuffers.animation[5] = 0b10100111;
+        framebuffers.animation[6] = 0b10001111;
+        framebuffers.animation[7] = 0b11011111;
+    } else if (counter == 3) {
+        framebuffers.animation[0] = 0b00000000;
+        framebuffers.animation[1] = 0b00000000;
+        framebuffers.animation[2] = 0b00000000;
+        framebuffers.animation[3] = 0b00000000;
+        framebuffers.animation[4] = 0b00000101;
+        framebuffers.animation[5] = 0b11110111;
+        framebuffers.animation[6] = 0b10101111;
+        framebuffers.animation[7] = 0b11011111;
+    } else if (counter == 4) {
+        framebuffers.animation[0] = 0b00000000;
+        framebuffers.animation[1] = 0b00000000;
+        framebuffers.animation[2] = 0b00000000;
+        framebuffers.animation[3] = 0b00000000;
+        framebuffers.animation[4] = 0b00000101;
+        framebuffers.animation[5] = 0b10000111;
+        framebuffers.animation[6] = 0b11111111;
+        framebuffers.animation[7] = 0b11111111;
+    }
+
+    counter++;
+    if (counter == 5) {
+        counter = 0;
+    }
+
+    return framebuffers.animation;
+}
+
+static gametoy_actions_t tetris_actions = {
+        .right_button_action = &tetris_right_button_action,
+        .left_button_action = &tetris_left_button_action,
+        .up_button_action = &tetris_up_button_action,
+        .down_button_action = &tetris_down_button_action,
+        .layers = layers,
+        .layers_count = ARRAY_SIZE(layers),
+        .initialize = &tetris_initialize,
+        .autoplay_action = &tetris_autoplay_action};
+
+void tetris_game_install() {
+    gametoy_game_install(&tetris_actions, GAME_TYPE_TETRIS);
+    welcome_screen_animation_install(tetris_game_animation, GAME_TYPE_TETRIS);
+}
@@ -1,6 +1,6 @@
-#ifndef TETRIS_H_
-#define TETRIS_H_
-
-void tetris_game_install();
-
-#endif /* TETRIS_H_ */
+#ifndef TETRIS_H_
+#define TETRIS_H_
+
+void tetris_game_install();
+
+#endif /* TETRIS_H_ */
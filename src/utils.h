@@ -1,14 +1,34 @@
-#ifndef UTILS_H_
-#define UTILS_H_
-
-#define ARRAY_SIZE(Arr) (sizeof(Arr) / sizeof(Arr[0]))
-
-inline uint8_t utils_bit_is_set(uint16_t *value, uint8_t offset) {
-    return (*value >> offset) & (uint16_t) 1;
-}
-
-inline void utils_bit_set_to(uint16_t *value, uint8_t offset, uint8_t bit) {
-    *value = (*value & ~((uint16_t) 1 << offset)) | ((uint16_t) bit << offset);
-}
-
-#endif /* UTILS_H_ */
+#ifndef UTILS_H_
+#define UTILS_H_
+
+#define ARRAY_SIZE(Arr) (sizeof(Arr) / sizeof(Arr[0]))
+
+static inline uint8_t utils_bit_is_set(uint16_t *value, uint8_t offset) {
+    return (*value >> offset) & (uint16_t) 1;
+}
+
+static inline void
+utils_bit_set_to(uint16_t *value, uint8_t offset, uint8_t bit) {
+    *value = (*value & ~((uint16_t) 1 << offset)) | ((uint16_t) bit << offset);
+}
+
+static inline uint8_t utils_popcount(uint16_t value) {
+    uint8_t count = 0;
+    for (; value; value &= value - 1) {
+        count++;
+    }
+
+    return count;
+}
+
+// value must not be 0
+static inline uint8_t utils_lowest_bit(uint16_t value) {
+    uint8_t offset = 0;
+    for (; !(value & 1); value >>= 1) {
+        offset++;
+    }
+
+    return offset;
+}
+
+#endif /* UTILS_H_ */
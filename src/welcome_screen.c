@@ -1,139 +1,139 @@
-#include <inttypes.h>
-#include <string.h>
-
-#include "gametoy.h"
-#include "welcome_screen.h"
-
-typedef enum { DIRECTION_UP, DIRECTION_DOWN } direction_t;
-
-const static uint8_t ARROW_BITMAP[8] = {0b00000000, 0b00001000, 0b00001100,
-                                        0b11111110, 0b11111110, 0b00001100,
-                                        0b00001000, 0b00000000};
-
-static welcome_screen_get_game_animation_t *games_animations[_GAME_TYPE_COUNT];
-static game_type_t installed_games[_GAME_TYPE_COUNT];
-static uint8_t installed_games_count;
-static uint8_t arrow_index;
-static uint16_t welcome_screen_framebuffer[GAMETOY_DISPLAY_SIZE];
-
-static uint8_t *get_animation(game_type_t game) {
-    return games_animations[game]();
-}
-
-static void move_arrow(direction_t direction) {
-    uint8_t previous_arrow_index = arrow_index;
-    if (direction == DIRECTION_DOWN) {
-        if (arrow_index + 1 == installed_games_count) {
-            return;
-        }
-        arrow_index++;
-    } else {
-        if (arrow_index + 1 == 1) {
-            return;
-        }
-        arrow_index--;
-    }
-
-    for (uint8_t i = 0; i < WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE; i++) {
-        welcome_screen_framebuffer[i + 8 * previous_arrow_index] &=
-                ~(0xff << 8);
-        welcome_screen_framebuffer[i + 8 * arrow_index] |= ARROW_BITMAP[i] << 8;
-    }
-}
-
-static void welcome_screen_right_button_action(void) {
-    gametoy_game_select(installed_games[arrow_index]);
-    gametoy_game_run();
-}
-
-static void welcome_screen_left_button_action(void) {
-    return;
-}
-
-static void welcome_screen_up_button_action(void) {
-    move_arrow(DIRECTION_UP);
-}
-
-static void welcome_screen_down_button_action(void) {
-    move_arrow(DIRECTION_DOWN);
-}
-
-static void update_animations(void) {
-    for (uint8_t i = 0; i < installed_games_count; i++) {
-        uint8_t *animation = get_animation(installed_games[i]);
-        for (uint8_t j = 0; j < WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE;
-             j++) {
-            welcome_screen_framebuffer[j + 8 * i] &= 0xff00;
-            welcome_screen_framebuffer[j + 8 * i] |= (uint16_t) animation[j];
-        }
-    }
-}
-
-static bool welcome_screen_periodic_action(uint32_t delay_ms) {
-    static uint32_t periodic_elapsed_ms;
-
-    periodic_elapsed_ms += delay_ms;
-    if (periodic_elapsed_ms < 300) {
-        return false;
-    }
-
-    periodic_elapsed_ms = 0;
-    update_animations();
-
-    return true;
-}
-
-static void
-welcome_screen_update_gametoy_framebuffer(uint16_t *gametoy_framebuffer) {
-    memcpy(gametoy_framebuffer, welcome_screen_framebuffer,
-           GAMETOY_DISPLAY_SIZE * sizeof(uint16_t));
-}
-
-void welcome_screen_initialize(void) {
-    for (game_type_t game = 0; game < _GAME_TYPE_COUNT; game++) {
-        installed_games[game] = _GAME_TYPE_COUNT;
-        if (games_animations[game]) {
-            installed_games[installed_games_count] = game;
-            installed_games_count++;
-        }
-    }
-
-    if (installed_games_count == 0) {
-        while (1)
-            ;
-    }
-
-    for (uint8_t i = 0; i < WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE; i++) {
-        welcome_screen_framebuffer[i] = ARROW_BITMAP[i] << 8;
-    }
-
-    for (uint8_t i = 0; i < installed_games_count; i++) {
-        uint8_t *animation = get_animation(installed_games[i]);
-        for (uint8_t j = 0; j < WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE;
-             j++) {
-            welcome_screen_framebuffer[j + 8 * i] |= (uint16_t) animation[i];
-        }
-    }
-}
-
-void welcome_screen_animation_install(
-        welcome_screen_get_game_animation_t *animation, game_type_t game_type) {
-    if (game_type == _GAME_TYPE_COUNT || game_type == GAME_TYPE_NONE) {
-        return;
-    }
-
-    games_animations[game_type] = animation;
-}
-
-static gametoy_actions_t welcome_screen_actions = {
-        .right_button_action = &welcome_screen_right_button_action,
-        .left_button_action = &welcome_screen_left_button_action,
-        .up_button_action = &welcome_screen_up_button_action,
-        .down_button_action = &welcome_screen_down_button_action,
-        .periodic_action = &welcome_screen_periodic_action,
-        .update_gametoy_framebuffer =
-                &welcome_screen_update_gametoy_framebuffer};
-
-void welcome_screen_install() {
-    gametoy_game_install(&welcome_screen_actions, GAME_TYPE_NONE);
-}
+#include <inttypes.h>
+
+#include "gametoy.h"
+#include "welcome_screen.h"
+
+typedef enum { DIRECTION_UP, DIRECTION_DOWN } direction_t;
+
+// the selected game starts playing itself after this long without a press
+#define DEMO_IDLE_MS 20000
+#define ANIMATION_PERIOD_MS 300
+
+const static uint16_t ARROW_BITMAP[8] = {
+        0b00000000 << 8, 0b00001000 << 8, 0b00001100 << 8, 0b11111110 << 8,
+        0b11111110 << 8, 0b00001100 << 8, 0b00001000 << 8, 0b00000000 << 8};
+
+static welcome_screen_get_game_animation_t *games_animations[_GAME_TYPE_COUNT];
+static game_type_t installed_games[_GAME_TYPE_COUNT];
+static uint8_t installed_games_count;
+static uint8_t arrow_index;
+static gametoy_timer_t animation_timer;
+static gametoy_timer_t idle_timer;
+// the arrow, then the animation of every installed game
+static display_layer_t welcome_screen_layers[1 + _GAME_TYPE_COUNT];
+
+static uint16_t *get_animation(game_type_t game) {
+    return games_animations[game]();
+}
+
+static void move_arrow(direction_t direction) {
+    if (direction == DIRECTION_DOWN) {
+        if (arrow_index + 1 == installed_games_count) {
+            return;
+        }
+        arrow_index++;
+    } else {
+        if (arrow_index + 1 == 1) {
+            return;
+        }
+        arrow_index--;
+    }
+
+    welcome_screen_layers[0].first_row =
+            WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE * arrow_index;
+}
+
+static void run_demo(void);
+
+static void idle_timer_restart(void) {
+    gametoy_timer_start(&idle_timer, DEMO_IDLE_MS, 0, run_demo);
+}
+
+static void run_demo(void) {
+    // stays on the welcome screen if the game has no demo
+    idle_timer_restart();
+    gametoy_game_select(installed_games[arrow_index]);
+    gametoy_game_run_demo();
+}
+
+static void welcome_screen_right_button_action(void) {
+    gametoy_game_select(installed_games[arrow_index]);
+    gametoy_game_run();
+}
+
+static void welcome_screen_left_button_action(void) {
+    run_demo();
+}
+
+static void welcome_screen_up_button_action(void) {
+    idle_timer_restart();
+    move_arrow(DIRECTION_UP);
+}
+
+static void welcome_screen_down_button_action(void) {
+    idle_timer_restart();
+    move_arrow(DIRECTION_DOWN);
+}
+
+static void update_animations(void) {
+    // the games animate in place, their layers show the new frame right away
+    for (uint8_t i = 0; i < installed_games_count; i++) {
+        get_animation(installed_games[i]);
+    }
+}
+
+static void welcome_screen_start(void) {
+    gametoy_timer_start(&animation_timer, ANIMATION_PERIOD_MS,
+                        ANIMATION_PERIOD_MS, update_animations);
+    idle_timer_restart();
+}
+
+static gametoy_actions_t welcome_screen_actions = {
+        .right_button_action = &welcome_screen_right_button_action,
+        .left_button_action = &welcome_screen_left_button_action,
+        .up_button_action = &welcome_screen_up_button_action,
+        .down_button_action = &welcome_screen_down_button_action,
+        .layers = welcome_screen_layers,
+        .initialize = &welcome_screen_start};
+
+void welcome_screen_initialize(void) {
+    for (game_type_t game = 0; game < _GAME_TYPE_COUNT; game++) {
+        installed_games[game] = _GAME_TYPE_COUNT;
+        if (games_animations[game]) {
+            installed_games[installed_games_count] = game;
+            installed_games_count++;
+        }
+    }
+
+    if (installed_games_count == 0) {
+        while (1)
+            ;
+    }
+
+    welcome_screen_layers[0] = (display_layer_t){
+            .rows = ARROW_BITMAP,
+            .first_row = 0,
+            .row_count = WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE,
+            .planes = DISPLAY_LAYER_FULL};
+    for (uint8_t i = 0; i < installed_games_count; i++) {
+        welcome_screen_layers[1 + i] = (display_layer_t){
+                .rows = get_animation(installed_games[i]),
+                .first_row = WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE * i,
+                .row_count = WELCOME_SCREEN_ANIMATION_FRAMEBUFFER_SIZE,
+                .planes = DISPLAY_LAYER_FULL};
+    }
+    welcome_screen_actions.layers_count = 1 + installed_games_count;
+}
+
+void welcome_screen_animation_install(
+        welcome_screen_get_game_animation_t *animation, game_type_t game_type) {
+    if (game_type == _GAME_TYPE_COUNT || game_type == GAME_TYPE_NONE) {
+        return;
+    }
+
+    games_animations[game_type] = animation;
+}
+
+void welcome_screen_install() {
+    gametoy_game_install(&welcome_screen_actions, GAME_TYPE_NONE);
+}